@@ -1,6 +1,5 @@
 #include "tools.h"
 #include <iostream>
-unsigned int global_clock=0;
 struct RegFile_Input {
 	Wire <5> rs1_index;		// Read
 	Wire <5> rs2_index;		// Read
@@ -78,14 +77,14 @@ signed main() {
 	cpu.add_module(&ins_decode);
 	cpu.add_module(&reg_file);
 
-	reg_file.rs1_index = [&]() -> auto & { return ins_decode.rs1_index; };
-	reg_file.rs2_index = [&]() -> auto & { return ins_decode.rs2_index; };
-	reg_file.wb_index = [&]() -> auto & { return ins_decode.wb_index; };
-	reg_file.wb_enable = [&]() -> auto & { return ins_decode.wb_enable; };
-	reg_file.wb_data = [&]() -> auto & { return ins_decode.wb_data; };
+	reg_file.rs1_index = ins_decode.rs1_index;
+	reg_file.rs2_index = ins_decode.rs2_index;
+	reg_file.wb_index = ins_decode.wb_index;
+	reg_file.wb_enable = ins_decode.wb_enable;
+	reg_file.wb_data = ins_decode.wb_data;
 
-	ins_decode.rs1_data = [&]() -> auto & { return reg_file.rs1_data; };
-	ins_decode.rs2_data = [&]() -> auto & { return reg_file.rs2_data; };
+	ins_decode.rs1_data = reg_file.rs1_data;
+	ins_decode.rs2_data = reg_file.rs2_data;
 
 	cpu.run(114514, true);
 
@@ -18,7 +18,7 @@ struct ALU_Output {
   dark::Register<32> result;
   dark::Register<32> completed_alu_resulting_PC;
 };
-struct ALU : public dark::Module<ALU_Input, ALU_Output> {
+struct ALU : public dark::PureModule<ALU_Input, ALU_Output> {
   ALU() {
     // Constructor
   }
@@ -0,0 +1,70 @@
+#pragma once
+#include "concept.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace dark {
+
+/**
+ * Many independent machines of the same kind, the lanes, e.g. one per program.
+ * Each host thread takes the next lane that has not started and runs it until it halts,
+ * so lanes of different lengths keep every thread busy.
+ * A machine is anything with a `cpu` member, such as ZYM::Machine, and keeps all of its state,
+ * so lanes never share anything but the thread that runs them.
+ */
+template<typename _Machine>
+class Batch {
+public:
+	struct Lane {
+		std::unique_ptr<_Machine> machine;
+		std::uint8_t exit_code = 0;
+		bool halted = false;
+	};
+
+private:
+	std::vector<Lane> _M_lanes;
+
+	static bool _S_halted(_Machine &machine) {
+		return (static_cast<max_size_t>(machine.cpu.halt_signal) >> 8 & 1) != 0;
+	}
+
+	/* Run the lanes not taken yet, one after another. */
+	void _M_run_lanes(std::atomic<std::size_t> &next, unsigned long long max_cycles) {
+		for (std::size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < this->_M_lanes.size();) {
+			auto &lane = this->_M_lanes[i];
+			if (lane.halted) continue;
+			lane.exit_code = lane.machine->cpu.run(max_cycles);
+			lane.halted = _S_halted(*lane.machine);
+		}
+	}
+
+public:
+	/* Add a lane and return its machine, to load a program into. */
+	_Machine &add() {
+		auto &lane = this->_M_lanes.emplace_back();
+		lane.machine = std::make_unique<_Machine>();
+		return *lane.machine;
+	}
+
+	std::size_t size() const { return this->_M_lanes.size(); }
+
+	const Lane &operator[](std::size_t index) const { return this->_M_lanes[index]; }
+
+	/* Run every lane until it halts, or until max_cycles if that is not 0. */
+	void run(std::size_t threads = 1, unsigned long long max_cycles = 0) {
+		threads = std::clamp<std::size_t>(threads, 1, std::max<std::size_t>(this->_M_lanes.size(), 1));
+		std::atomic<std::size_t> next(0);
+		if (threads == 1) return this->_M_run_lanes(next, max_cycles);
+		// each thread runs whole programs, so plain threads do; WorkerPool is for per-cycle hand-offs
+		std::vector<std::thread> pool;
+		for (std::size_t t = 0; t < threads; ++t)
+			pool.emplace_back([&] { this->_M_run_lanes(next, max_cycles); });
+		for (auto &thread: pool) thread.join();
+	}
+};
+
+} // namespace dark
@@ -0,0 +1,59 @@
+#pragma once
+#include "concept.h"
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+/**
+ * Binary encoding of CPU checkpoints.
+ * Integers are little-endian and take exactly the given number of bytes.
+ */
+namespace dark::checkpoint {
+
+static constexpr char kMagic[8] = {'D', 'A', 'R', 'K', 'C', 'K', 'P', 'T'};
+static constexpr std::uint32_t kVersion = 3;
+
+template<std::size_t _Len>
+static constexpr std::size_t kBytes = (_Len + 7) / 8;
+
+inline void write_data(std::ostream &out, const void *data, std::size_t size) {
+	out.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+}
+
+inline void read_data(std::istream &in, void *data, std::size_t size) {
+	in.read(static_cast<char *>(data), static_cast<std::streamsize>(size));
+	if (static_cast<std::size_t>(in.gcount()) != size)
+		throw std::runtime_error("Checkpoint: unexpected end of data.");
+}
+
+inline void write_uint(std::ostream &out, std::uint64_t value, std::size_t bytes) {
+	unsigned char buf[8];
+	for (std::size_t i = 0; i < bytes; ++i)
+		buf[i] = static_cast<unsigned char>(value >> (i * 8));
+	write_data(out, buf, bytes);
+}
+
+inline std::uint64_t read_uint(std::istream &in, std::size_t bytes) {
+	unsigned char buf[8];
+	read_data(in, buf, bytes);
+	std::uint64_t value = 0;
+	for (std::size_t i = 0; i < bytes; ++i)
+		value |= std::uint64_t(buf[i]) << (i * 8);
+	return value;
+}
+
+inline void write_string(std::ostream &out, const std::string &str) {
+	write_uint(out, str.size(), 8);
+	write_data(out, str.data(), str.size());
+}
+
+inline std::string read_string(std::istream &in) {
+	std::string str(read_uint(in, 8), '\0');
+	read_data(in, str.data(), str.size());
+	return str;
+}
+
+} // namespace dark::checkpoint
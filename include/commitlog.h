@@ -0,0 +1,159 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * A compact binary log of committed instructions, written by the interpreter with --commit-log.
+ * The file is the magic, then one variable-size record per instruction:
+ * a flags byte; the PC as a zigzag varint of its distance from the PC after the last record, unless kNextPc;
+ * the instruction; rd and its new value if kWritesRd; the address and data if kMemory.
+ * Words are 4 bytes, little endian. Decode the file offline, e.g. with the commitdump tool.
+ */
+namespace dark::commitlog {
+
+static constexpr char kMagic[8] = {'D', 'A', 'R', 'K', 'C', 'M', 'L', '1'};
+
+enum Flags : std::uint8_t {
+	kNextPc = 1,	// the PC is 4 after the PC of the last record
+	kWritesRd = 2,
+	kMemory = 4,	// a load or a store, with the address and the data loaded or stored
+};
+
+struct Record {
+	std::uint32_t pc;
+	std::uint32_t instruction;
+	std::uint8_t flags;
+	std::uint8_t rd;
+	std::uint32_t value;
+	std::uint32_t addr;
+	std::uint32_t data;
+};
+
+class Writer {
+private:
+	static constexpr std::size_t kFlushSize = 1 << 16;
+
+	std::FILE *_M_file;
+	std::uint32_t _M_next_pc = 0;
+	std::vector<unsigned char> _M_buffer;
+
+	void _M_word(std::uint32_t value) {
+		for (int i = 0; i < 4; ++i)
+			this->_M_buffer.push_back(static_cast<unsigned char>(value >> (i * 8)));
+	}
+
+public:
+	explicit Writer(const std::string &path) : _M_file(std::fopen(path.c_str(), "wb")) {
+		if (this->_M_file == nullptr)
+			throw std::runtime_error("Writer: cannot open " + path);
+		std::fwrite(kMagic, 1, sizeof(kMagic), this->_M_file);
+		this->_M_buffer.reserve(kFlushSize + 32);
+	}
+
+	Writer(const Writer &) = delete;
+	Writer &operator=(const Writer &) = delete;
+
+	~Writer() {
+		this->flush();
+		std::fclose(this->_M_file);
+	}
+
+	/* Only kWritesRd and kMemory of the flags are used, kNextPc is found here. */
+	void write(const Record &record) {
+		const auto delta = static_cast<std::int32_t>(record.pc - this->_M_next_pc);
+		const auto flags = static_cast<std::uint8_t>((record.flags & (kWritesRd | kMemory)) | (delta == 0 ? kNextPc : 0));
+		this->_M_buffer.push_back(flags);
+		if (delta != 0) {
+			auto zigzag = static_cast<std::uint32_t>(delta) << 1 ^ static_cast<std::uint32_t>(delta >> 31);
+			for (; zigzag >= 0x80; zigzag >>= 7)
+				this->_M_buffer.push_back(static_cast<unsigned char>(zigzag | 0x80));
+			this->_M_buffer.push_back(static_cast<unsigned char>(zigzag));
+		}
+		this->_M_word(record.instruction);
+		if (flags & kWritesRd) {
+			this->_M_buffer.push_back(record.rd);
+			this->_M_word(record.value);
+		}
+		if (flags & kMemory) {
+			this->_M_word(record.addr);
+			this->_M_word(record.data);
+		}
+		this->_M_next_pc = record.pc + 4;
+		if (this->_M_buffer.size() >= kFlushSize) this->flush();
+	}
+
+	void flush() {
+		std::fwrite(this->_M_buffer.data(), 1, this->_M_buffer.size(), this->_M_file);
+		this->_M_buffer.clear();
+	}
+};
+
+class Reader {
+private:
+	std::FILE *_M_file;
+	std::uint32_t _M_next_pc = 0;
+
+	bool _M_byte(std::uint8_t &value) {
+		const int c = std::fgetc(this->_M_file);
+		value = static_cast<std::uint8_t>(c);
+		return c != EOF;
+	}
+
+	bool _M_word(std::uint32_t &value) {
+		unsigned char bytes[4];
+		if (std::fread(bytes, 1, sizeof(bytes), this->_M_file) != sizeof(bytes)) return false;
+		value = 0;
+		for (int i = 3; i >= 0; --i) value = value << 8 | bytes[i];
+		return true;
+	}
+
+public:
+	explicit Reader(const std::string &path) : _M_file(std::fopen(path.c_str(), "rb")) {
+		if (this->_M_file == nullptr)
+			throw std::runtime_error("Reader: cannot open " + path);
+		char magic[sizeof(kMagic)];
+		if (std::fread(magic, 1, sizeof(magic), this->_M_file) != sizeof(magic)
+				|| std::memcmp(magic, kMagic, sizeof(magic)) != 0) {
+			std::fclose(this->_M_file);
+			throw std::runtime_error("Reader: not a commit log: " + path);
+		}
+	}
+
+	Reader(const Reader &) = delete;
+	Reader &operator=(const Reader &) = delete;
+
+	~Reader() { std::fclose(this->_M_file); }
+
+	/* False at the end of the file; a record cut short throws. */
+	bool next(Record &record) {
+		if (!this->_M_byte(record.flags)) return false;
+		record.pc = this->_M_next_pc;
+		bool ok = true;
+		if (!(record.flags & kNextPc)) {
+			std::uint32_t zigzag = 0;
+			std::uint8_t byte = 0x80;
+			for (int shift = 0; ok && (byte & 0x80) && shift < 35; shift += 7) {
+				ok = this->_M_byte(byte);
+				zigzag |= static_cast<std::uint32_t>(byte & 0x7F) << shift;
+			}
+			record.pc += zigzag >> 1 ^ (0 - (zigzag & 1));
+		}
+		ok = ok && this->_M_word(record.instruction);
+		record.rd = 0;
+		record.value = 0;
+		if (ok && (record.flags & kWritesRd)) ok = this->_M_byte(record.rd) && this->_M_word(record.value);
+		record.addr = 0;
+		record.data = 0;
+		if (ok && (record.flags & kMemory)) ok = this->_M_word(record.addr) && this->_M_word(record.data);
+		if (!ok)
+			throw std::runtime_error("Reader: the commit log is truncated.");
+		this->_M_next_pc = record.pc + 4;
+		return true;
+	}
+};
+
+} // namespace dark::commitlog
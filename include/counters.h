@@ -0,0 +1,76 @@
+#pragma once
+#include <concepts>
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace dark {
+
+/**
+ * Named 64-bit counters, see ModuleBase::register_counters.
+ * The counters stay plain integers owned by the modules; the registry only reads them,
+ * e.g. to export the statistics of a run as JSON or CSV.
+ */
+class CounterRegistry {
+private:
+	struct Entry {
+		std::string name;
+		const void *value;
+		std::uint64_t (*read)(const void *);
+	};
+	std::vector<Entry> _M_entries;
+
+	const Entry *_M_find(const std::string &name) const {
+		for (auto &entry: this->_M_entries)
+			if (entry.name == name) return &entry;
+		return nullptr;
+	}
+
+public:
+	/* Register a counter, which must outlive the registry. Names are unique, e.g. "csu.flushes". */
+	template<std::integral _Tp>
+	void add(std::string name, const _Tp &counter) {
+		if (this->_M_find(name) != nullptr)
+			throw std::invalid_argument("CounterRegistry: duplicate counter " + name);
+		this->_M_entries.push_back({std::move(name), &counter, [](const void *ptr) {
+			return static_cast<std::uint64_t>(*static_cast<const _Tp *>(ptr));
+		}});
+	}
+
+	std::size_t size() const { return this->_M_entries.size(); }
+
+	bool contains(const std::string &name) const { return this->_M_find(name) != nullptr; }
+
+	std::uint64_t value(const std::string &name) const {
+		const auto *entry = this->_M_find(name);
+		if (entry == nullptr)
+			throw std::out_of_range("CounterRegistry: no counter " + name);
+		return entry->read(entry->value);
+	}
+
+	/* One object, with the counters in the order they were registered. */
+	void write_json(std::ostream &out) const {
+		out << "{";
+		for (std::size_t i = 0; i < this->_M_entries.size(); ++i) {
+			auto &entry = this->_M_entries[i];
+			out << (i == 0 ? "\n" : ",\n") << "  \"";
+			for (char c: entry.name) {
+				if (c == '"' || c == '\\') out << '\\';
+				out << c;
+			}
+			out << "\": " << entry.read(entry.value);
+		}
+		out << "\n}\n";
+	}
+
+	/* A header line, then one "name,value" line per counter. */
+	void write_csv(std::ostream &out) const {
+		out << "counter,value\n";
+		for (auto &entry: this->_M_entries)
+			out << entry.name << ',' << entry.read(entry.value) << '\n';
+	}
+};
+
+} // namespace dark
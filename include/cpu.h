@@ -1,12 +1,24 @@
 #pragma once
+#include "checkpoint.h"
 #include "concept.h"
+#include "heartbeat.h"
 #include "module.h"
+#include "parallel.h"
+#include "profile.h"
+#include "statehash.h"
+#include "waveform.h"
 #include "wire.h"
 #include <algorithm>
+#include <limits>
 #include <memory>
 #include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
 #include <vector>
-extern unsigned int global_clock;
 
 namespace dark {
 
@@ -14,16 +26,83 @@ class CPU {
 private:
 	std::vector<std::unique_ptr<ModuleBase>> mod_owned;
 	std::vector<ModuleBase *> modules;
+	details::DirtyList dirty_list;
+	RegisterBank bank;
   bool reset_signal = false;
 
+	/* State of the parallel mode, see set_threads. The pool is declared last to stop first. */
+	std::vector<details::DirtyList> pool_lists;
+	details::WorkerPool::Job pool_work;
+	details::WorkerPool::Job pool_sync;
+	std::size_t pool_epoch = 0;
+	std::unique_ptr<details::WorkerPool> pool;
+
+	std::default_random_engine shuffle_engine;
+	std::vector<ModuleBase *> shuffled;
+
+	/* Per module state of the clock gating, see set_clock_gating. */
+	struct Gate {
+		std::vector<max_size_t> inputs;
+		std::size_t begin = 0;	// range of its registers in the dirty list
+		std::size_t end = 0;
+		bool changed = true;	// whether its registers changed in the last cycle
+		bool sampled = false;	// whether inputs hold the values of the last cycle
+		bool skipped = false;
+	};
+	std::vector<Gate> gates;
+	bool gating = false;
+	bool gating_verify = false;
+
+	/* State of the profiled mode, see set_profiling. */
+	std::vector<profile::ModuleStats> profile_stats;
+	std::vector<std::size_t> profile_ends;
+	std::unique_ptr<profile::PerfCounters> perf;
+	bool profiling = false;
+
+	wave::Dumper *waveform = nullptr;
+
+	Heartbeat *heartbeat = nullptr;
+
+	hash::Recorder *state_log = nullptr;
+
+	/* Lambda wires in topological order, see set_eager_wires. */
+	std::vector<details::WireNode> eager_wires;
+	bool eager = false;
+	unsigned long long heartbeat_next = std::numeric_limits<unsigned long long>::max();
+
+	/* The last wire epoch of this CPU, on whichever thread it ran, see run. */
+	std::size_t epoch = 0;
+
 public:
 	unsigned long long cycles = 0;
+	/* Cycles finished without halting, as seen by ModuleBase::clock. */
+	unsigned int clock = 0;
+	unsigned long long skipped_works = 0;
   dark::Wire<9> halt_signal;
+	/* The counters of the CPU and of every module added, see ModuleBase::register_counters. */
+	CounterRegistry counters;
+
+	CPU() {
+		counters.add("cpu.cycles", cycles);
+		counters.add("cpu.skipped_works", skipped_works);
+	}
+	CPU(const CPU &) = delete;
+	CPU &operator=(const CPU &) = delete;
 
 private:
+	/* Commit the registers assigned in this cycle and invalidate all wires. */
 	void sync_all() {
-		for (auto &module: modules)
-			module->sync();
+		dirty_list.commit();
+		bank.commit();
+		epoch = ++details::wire_epoch;
+	}
+
+	template<typename _Range>
+	void work_all(const _Range &range) {
+		auto *previous = std::exchange(details::active_dirty_list, &dirty_list);
+		for (auto &module: range)
+			module->work();
+		details::active_dirty_list = previous;
 	}
 
 public:
@@ -31,53 +110,435 @@ public:
 	template<typename _Tp>
 		requires std::derived_from<_Tp, ModuleBase>
 	void add_module(std::unique_ptr<_Tp> &module) {
-		modules.push_back(module.get());
+		add_module(module.get());
 		mod_owned.emplace_back(std::move(module));
 	}
 	void add_module(std::unique_ptr<ModuleBase> module) {
-		modules.push_back(module.get());
+		add_module(module.get());
 		mod_owned.emplace_back(std::move(module));
 	}
+	/// @note with DARK_REGISTER_BANK, the registers of the module are moved into the bank of this CPU.
 	void add_module(ModuleBase *module) {
 		modules.push_back(module);
+		module->_M_clock = &clock;
+		module->register_counters(counters);
+		if constexpr (RegisterBank::enabled)
+			module->bind(bank);
 	}
 
 	void run_once() {
 		++cycles;
-		for (auto &module: modules)
-			module->work();
+		work_all(modules);
 		sync_all();
 	}
+	void set_shuffle_seed(unsigned int seed) { shuffle_engine.seed(seed); }
 	void run_once_shuffle() {
-		static std::default_random_engine engine;
-		std::vector<ModuleBase *> shuffled = modules;
-		std::shuffle(shuffled.begin(), shuffled.end(), engine);
+		// Shuffle the order of the last cycle again, so that no cycle allocates.
+		if (shuffled.size() != modules.size()) shuffled = modules;
+		std::shuffle(shuffled.begin(), shuffled.end(), shuffle_engine);
 
 		++cycles;
-		for (auto &module: shuffled)
-			module->work();
+		work_all(shuffled);
 		sync_all();
 	}
+	/**
+	 * Spread work() and the commit over a pool of threads, used by run_once_parallel.
+	 * Module i runs on thread i % threads, and each thread keeps its own dirty list.
+	 * 0 or 1 thread disables the pool.
+	 * @attention modules must only communicate through registers and wires,
+	 * exactly as required for run_once_shuffle.
+	 * Needs DARK_REGISTER_BANK, otherwise throws: the old and new value of a register without a bank
+	 * are bit-fields of one memory location, so a worker assigning it races with the readers of the old value.
+	 */
+	void set_threads(std::size_t threads) {
+		pool.reset();
+		if (threads <= 1) return;
+#ifndef DARK_REGISTER_BANK
+		throw std::runtime_error("CPU: the parallel mode needs the register bank, compile with DARK_REGISTER_BANK.");
+#endif
+		pool_lists = std::vector<details::DirtyList>(threads);
+		pool_work = [this, threads](std::size_t index) {
+			details::wire_epoch = pool_epoch;
+			auto *previous = std::exchange(details::active_dirty_list, &pool_lists[index]);
+			for (std::size_t i = index; i < modules.size(); i += threads)
+				modules[i]->work();
+			details::active_dirty_list = previous;
+		};
+		pool_sync = [this, threads](std::size_t index) {
+			bank.commit(index, threads);
+			pool_lists[index].commit();
+		};
+		pool = std::make_unique<details::WorkerPool>(threads);
+	}
+	void run_once_parallel() {
+		if (pool == nullptr) return run_once();
+		++cycles;
+		pool_epoch = details::wire_epoch;
+		pool->run(pool_work);
+		pool->run(pool_sync);
+		epoch = ++details::wire_epoch;
+	}
+	/**
+	 * Skip work() of a module when it is idle, its input wires read the same values
+	 * as in the last cycle, and its last work() changed none of its registers.
+	 * Then work() would assign the very same values again, so skipping it changes nothing.
+	 * With verify, skipped modules still work, and a runtime_error is thrown if any
+	 * of their registers changes.
+	 * @attention wires must only depend on registers and the reset signal,
+	 * not on state hidden elsewhere.
+	 */
+	void set_clock_gating(bool enable, bool verify = false) {
+		gating = enable;
+		gating_verify = verify;
+		dirty_list.list_bound = enable;
+		gates.clear();
+	}
+	void run_once_gated() {
+		gates.resize(modules.size());
+		++cycles;
+		auto *previous = std::exchange(details::active_dirty_list, &dirty_list);
+		for (std::size_t i = 0; i < modules.size(); ++i) {
+			auto &gate = gates[i];
+			// Inputs are only sampled for candidates, so the snapshot is stale after other cycles.
+			if (!gate.changed && modules[i]->idle()) {
+				const bool inputs_changed = modules[i]->sample_inputs(gate.inputs);
+				gate.skipped = gate.sampled && !inputs_changed;
+				gate.sampled = true;
+			} else {
+				gate.skipped = false;
+				gate.sampled = false;
+			}
+			gate.begin = dirty_list.entries.size();
+			if (!gate.skipped || gating_verify)
+				modules[i]->work();
+			gate.end = dirty_list.entries.size();
+		}
+		details::active_dirty_list = previous;
+
+		for (auto &gate: gates) {
+			gate.changed = dirty_list.commit(gate.begin, gate.end);
+			if (!gate.skipped) continue;
+			++skipped_works;
+			if (gate.changed)
+				throw std::runtime_error("CPU: clock gating skipped a module whose registers changed.");
+		}
+		dirty_list.entries.clear();
+		bank.commit();
+		epoch = ++details::wire_epoch;
+	}
+	/**
+	 * Write the state of every module, together with the cycle counters, to a binary checkpoint.
+	 * Should be called between cycles, e.g. after run(max_cycles) returns.
+	 */
+	void save(std::ostream &out) {
+		out.write(checkpoint::kMagic, sizeof(checkpoint::kMagic));
+		checkpoint::write_uint(out, checkpoint::kVersion, 4);
+		checkpoint::write_uint(out, cycles, 8);
+		checkpoint::write_uint(out, clock, 4);
+		std::ostringstream engine;
+		engine << shuffle_engine;
+		checkpoint::write_string(out, engine.str());
+		checkpoint::write_uint(out, modules.size(), 8);
+		for (auto *module: modules) {
+			std::ostringstream buf;
+			module->save(buf);
+			checkpoint::write_string(out, buf.str());
+		}
+		if (!out) throw std::runtime_error("Checkpoint: failed to write.");
+	}
+	/**
+	 * Restore a checkpoint written by save.
+	 * @attention the CPU must be built the same way, with the same modules added in the same order.
+	 */
+	void load(std::istream &in) {
+		char magic[sizeof(checkpoint::kMagic)];
+		checkpoint::read_data(in, magic, sizeof(magic));
+		if (!std::equal(magic, magic + sizeof(magic), checkpoint::kMagic)
+				|| checkpoint::read_uint(in, 4) != checkpoint::kVersion)
+			throw std::runtime_error("Checkpoint: not a checkpoint of this version.");
+		const auto saved_cycles = checkpoint::read_uint(in, 8);
+		const auto saved_clock = static_cast<unsigned int>(checkpoint::read_uint(in, 4));
+		std::istringstream engine(checkpoint::read_string(in));
+		if (checkpoint::read_uint(in, 8) != modules.size())
+			throw std::runtime_error("Checkpoint: the number of modules does not match.");
+		for (auto *module: modules) {
+			std::istringstream buf(checkpoint::read_string(in));
+			module->load(buf);
+			if (buf.peek() != std::istringstream::traits_type::eof())
+				throw std::runtime_error("Checkpoint: the layout of a module does not match.");
+		}
+		engine >> shuffle_engine;
+		cycles = saved_cycles;
+		clock = saved_clock;
+		gates.clear();
+		epoch = ++details::wire_epoch;
+	}
+	/**
+	 * Make run() use run_once_profiled, which measures work() and the commit of every module
+	 * in time stamp counter ticks, and with counters, in hardware events of work().
+	 * The measurement itself slows the run down, counters much more than ticks.
+	 */
+	void set_profiling(bool enable, bool counters = false) {
+		profiling = enable;
+		perf.reset(enable && counters ? new profile::PerfCounters : nullptr);
+		profile_stats.clear();
+	}
+	void run_once_profiled() {
+		if (profile_stats.size() != modules.size()) {
+			profile_stats.resize(modules.size());
+			profile_ends.resize(modules.size());
+			for (std::size_t i = 0; i < modules.size(); ++i)
+				profile_stats[i].name = profile::type_name(*modules[i]);
+		}
+		++cycles;
+		auto *previous = std::exchange(details::active_dirty_list, &dirty_list);
+		for (std::size_t i = 0; i < modules.size(); ++i) {
+			auto &stats = profile_stats[i];
+			const auto events = perf != nullptr ? perf->read() : profile::PerfCounters::Values{};
+			const auto start = profile::read_ticks();
+			modules[i]->work();
+			stats.work_ticks += profile::read_ticks() - start;
+			if (perf != nullptr) {
+				const auto now = perf->read();
+				for (std::size_t k = 0; k < now.size(); ++k)
+					stats.work_events[k] += now[k] - events[k];
+			}
+			++stats.calls;
+			profile_ends[i] = dirty_list.entries.size();
+		}
+		details::active_dirty_list = previous;
+
+		std::size_t begin = 0;
+		for (std::size_t i = 0; i < modules.size(); ++i) {
+			const auto start = profile::read_ticks();
+			dirty_list.commit(begin, profile_ends[i]);
+			profile_stats[i].sync_ticks += profile::read_ticks() - start;
+			begin = profile_ends[i];
+		}
+		dirty_list.entries.clear();
+		bank.commit();
+		epoch = ++details::wire_epoch;
+	}
+	/* Print the cost of every module measured so far by run_once_profiled. */
+	void print_profile(std::ostream &out) const {
+		if (perf != nullptr && !perf->available())
+			out << "perf_event_open is unavailable, only ticks are measured.\n";
+		profile::print(out, profile_stats, perf != nullptr && perf->available());
+	}
+	/**
+	 * Record the registers and connected wires of every module after each cycle of run(),
+	 * or stop recording with nullptr. Select signals and the window on the dumper beforehand.
+	 */
+	void set_waveform(wave::Dumper *dumper) {
+		waveform = dumper;
+		if (dumper != nullptr)
+			for (auto *module: modules) dumper->add_module(*module);
+	}
+	/**
+	 * A hash of the registers of every module and of their extra state, such as the memory,
+	 * in the order the modules were added. Two CPUs built the same way in the same state have the same hash.
+	 */
+	std::uint64_t state_hash() {
+		StateHash h;
+		for (auto *module: modules) module->hash(h);
+		return h.value();
+	}
+	/**
+	 * Record state_hash() at the end of every cycle of run() the recorder is due at,
+	 * or stop recording with nullptr.
+	 */
+	void set_state_hash(hash::Recorder *recorder) { state_log = recorder; }
+	/**
+	 * Let run() report its speed through the heartbeat, or stop with nullptr.
+	 * Costs one comparison per cycle; the heartbeat may throw to abort a run that is too slow.
+	 */
+	void set_heartbeat(Heartbeat *beat) {
+		heartbeat = beat;
+		heartbeat_next = beat != nullptr ? beat->start(cycles) : std::numeric_limits<unsigned long long>::max();
+	}
+	/**
+	 * Evaluate every lambda wire of the modules once per cycle, before work(), each after the wires it reads.
+	 * Reading a wire then never checks whether its cache is valid.
+	 * The wires read by each wire are found by evaluating it once, and a cycle among them
+	 * throws a runtime_error naming the wires on it.
+	 * @attention call it once all wires are connected. A wire must read the same wires in every cycle,
+	 * and between cycles, wires keep the values they had in the last cycle.
+	 */
+	void set_eager_wires(bool enable) {
+		for (auto &node: eager_wires) node.set_eager(node.wire, false);
+		eager_wires.clear();
+		eager = false;
+		if (!enable) return;
+
+		std::vector<details::WireNode> nodes;
+		for (auto *module: modules) {
+			const auto first = nodes.size();
+			module->collect_wires(nodes);
+			const auto scope = profile::type_name(*module);
+			for (auto i = first; i < nodes.size(); ++i) nodes[i].name = scope + '.' + nodes[i].name;
+		}
+		std::unordered_map<const void *, std::size_t> index;
+		for (std::size_t i = 0; i < nodes.size(); ++i) index[nodes[i].wire] = i;
+
+		// Every wire is eager while its reads are found, so that the lazy path never checks wire_reads.
+		std::vector<std::vector<std::size_t>> deps(nodes.size());
+		std::vector<const void *> reads;
+		for (auto &node: nodes) node.set_eager(node.wire, true);
+		auto *previous = std::exchange(details::wire_reads, &reads);
+		try {
+			for (std::size_t i = 0; i < nodes.size(); ++i) {
+				reads.clear();
+				nodes[i].evaluate(nodes[i].wire);
+				for (auto *wire: reads)
+					if (auto it = index.find(wire); it != index.end()) deps[i].push_back(it->second);
+			}
+		} catch (...) {
+			details::wire_reads = previous;
+			for (auto &node: nodes) node.set_eager(node.wire, false);
+			throw;
+		}
+		details::wire_reads = previous;
+
+		enum class Mark { none, visiting, done };
+		std::vector<Mark> marks(nodes.size(), Mark::none);
+		std::vector<std::size_t> path;
+		std::vector<details::WireNode> order;
+		auto visit = [&](auto &self, std::size_t i) -> void {
+			if (marks[i] == Mark::done) return;
+			if (marks[i] == Mark::visiting) {
+				std::string cycle;
+				auto it = std::find(path.begin(), path.end(), i);
+				for (; it != path.end(); ++it) cycle += nodes[*it].name + " -> ";
+				throw std::runtime_error("CPU: combinational cycle among wires: " + cycle + nodes[i].name);
+			}
+			marks[i] = Mark::visiting;
+			path.push_back(i);
+			for (auto dep: deps[i]) self(self, dep);
+			path.pop_back();
+			marks[i] = Mark::done;
+			order.push_back(nodes[i]);
+		};
+		for (std::size_t i = 0; i < nodes.size(); ++i) visit(visit, i);
+
+		eager_wires = std::move(order);
+		for (auto &node: eager_wires) node.set_eager(node.wire, true);
+		eager = true;
+	}
+	void evaluate_wires() {
+		for (auto &node: eager_wires) node.evaluate(node.wire);
+	}
   bool GetResetSignal(){
     return reset_signal;
   }
+	/**
+	 * Run until the halt signal, or until max_cycles if that is not 0.
+	 * Shuffling, profiling, clock gating and the parallel mode each replace run_once,
+	 * so asking for more than one of them throws a runtime_error.
+	 */
 	uint8_t run(unsigned long long max_cycles = 0, bool shuffle = false) {
-		auto func = shuffle ? &CPU::run_once_shuffle : &CPU::run_once;
-    reset_signal=true;
+		if (int(shuffle) + int(profiling) + int(gating) + int(pool != nullptr) > 1)
+			throw std::runtime_error("CPU: shuffling, profiling, clock gating and the parallel mode cannot be combined.");
+		auto func = shuffle ? &CPU::run_once_shuffle
+				: profiling ? &CPU::run_once_profiled
+				: gating ? &CPU::run_once_gated
+				: pool != nullptr ? &CPU::run_once_parallel : &CPU::run_once;
+    reset_signal=cycles==0; // a restored or resumed CPU is not reset again
+		// The epoch is per thread, so a CPU resumed on another thread must move past every epoch
+		// it used before, or its wires would hit values cached in an earlier cycle.
+		details::wire_epoch = epoch = std::max(details::wire_epoch, epoch) + 1;
 		while (max_cycles == 0 || cycles < max_cycles) {
-      DEBUG_CERR<<"\nclock: "<<std::dec<<global_clock<<std::endl;
+      DEBUG_CERR<<"\nclock: "<<std::dec<<clock<<std::endl;
+			if (eager) evaluate_wires();
 			(this->*func)();
-      reset_signal=false;
-      halt_signal.sync();
+			// before anything reads a wire after the commit, which would cache reset into the next cycle
+			reset_signal = false;
+			if (waveform != nullptr) [[unlikely]] {
+				// eager wires still hold the values from before the commit
+				if (eager) evaluate_wires();
+				waveform->sample(cycles);
+			}
+			if (state_log != nullptr && state_log->due(cycles)) [[unlikely]]
+				state_log->record(cycles, state_hash());
+			if (cycles >= heartbeat_next) [[unlikely]]
+				heartbeat_next = heartbeat->poll(cycles);
       uint32_t halt_signal_value = static_cast<max_size_t>(halt_signal);
       DEBUG_CERR<<"simulator received halt_signal_value="<<std::dec<<halt_signal_value<<std::endl;
       if(halt_signal_value &(1<<8)) {
         return halt_signal_value&0xff;
       }
-      global_clock++;
+      clock++;
     }
     return 255;
 	}
 };
 
+/**
+ * A CPU over a fixed list of module types, kept in a tuple.
+ * work() is called without virtual dispatch, so the compiler may inline every module into one cycle loop.
+ * Only run_once is supported; the other run modes stay with CPU.
+ * @attention each module type must appear once, and the module added must be exactly of that type.
+ */
+template<typename... _Modules>
+class StaticCPU {
+	static_assert((std::derived_from<_Modules, ModuleBase> && ...),
+				  "StaticCPU: every module must derive from ModuleBase.");
+
+private:
+	std::tuple<_Modules *...> modules;
+	details::DirtyList dirty_list;
+	RegisterBank bank;
+	bool reset_signal = false;
+	/* The last wire epoch of this CPU, on whichever thread it ran, see CPU::run. */
+	std::size_t epoch = 0;
+
+	template<typename _Tp>
+	static void work_one(_Tp *module) { module->_Tp::work(); }
+
+public:
+	unsigned long long cycles = 0;
+	unsigned int clock = 0;
+	Wire<9> halt_signal;
+	CounterRegistry counters;
+
+	StaticCPU() { counters.add("cpu.cycles", cycles); }
+	StaticCPU(const StaticCPU &) = delete;
+	StaticCPU &operator=(const StaticCPU &) = delete;
+
+	template<typename _Tp>
+		requires (std::same_as<_Tp, _Modules> || ...)
+	void add_module(_Tp *module) {
+		std::get<_Tp *>(modules) = module;
+		module->_M_clock = &clock;
+		module->register_counters(counters);
+		if constexpr (RegisterBank::enabled)
+			module->bind(bank);
+	}
+
+	void run_once() {
+		++cycles;
+		auto *previous = std::exchange(details::active_dirty_list, &dirty_list);
+		std::apply([](auto *...module) { (work_one(module), ...); }, modules);
+		details::active_dirty_list = previous;
+		dirty_list.commit();
+		bank.commit();
+		epoch = ++details::wire_epoch;
+	}
+
+	bool GetResetSignal() { return reset_signal; }
+
+	uint8_t run(unsigned long long max_cycles = 0) {
+		reset_signal = cycles == 0;
+		details::wire_epoch = epoch = std::max(details::wire_epoch, epoch) + 1;
+		while (max_cycles == 0 || cycles < max_cycles) {
+			run_once();
+			reset_signal = false;
+			const auto halt_signal_value = static_cast<max_size_t>(halt_signal);
+			if (halt_signal_value & (1 << 8))
+				return halt_signal_value & 0xff;
+			++clock;
+		}
+		return 255;
+	}
+};
+
 } // namespace dark
@@ -7,9 +7,9 @@
 #ifndef CSU_H
 #include <array>
 #include <functional>
-#include <random>
 #include <tuple>
 #include "tools.h"
+#include "traceevents.h"
 namespace ZYM {
 const int kROBSize = 32;
 const int kTotalRegister = 32;
@@ -72,14 +72,16 @@ struct CentralScheduleUnit_Output {
   dark::Register<5> commit_ins_ROB_index;
 };
 struct ROBRecordType {
-  dark::Register<4> state;  // 0: no entry; 1: just issued; 2: waiting; 3: ready to commit
+  // the narrow registers share one word, read and assigned through the accessors below
+  dark::RegisterPack<4, 1, 5, 1, 1> flags;
   dark::Register<32> instruction;
-  dark::Register<1> has_resulting_register;
-  dark::Register<5> resulting_register_idx;
   dark::Register<32> resulting_register_value;
-  dark::Register<1> resulting_PC_ready;
   dark::Register<32> resulting_PC;
-  dark::Register<1> PC_mismatch_mark;
+  auto state() { return flags.field<0>(); }  // 0: no entry; 1: just issued; 2: waiting; 3: ready to commit
+  auto has_resulting_register() { return flags.field<1>(); }
+  auto resulting_register_idx() { return flags.field<2>(); }
+  auto resulting_PC_ready() { return flags.field<3>(); }
+  auto PC_mismatch_mark() { return flags.field<4>(); }
   // dark::Register<4> mem_request_type;  // see memory.h
   // dark::Register<32> mem_request_addr;
   // dark::Register<32> mem_request_data;
@@ -103,8 +105,37 @@ struct CentralScheduleUnit
   inline uint8_t ReadBit(uint32_t data, int pos) { return (data >> pos) & 1; }
   long long total_predictions = 0;
   long long incorrect_predictions = 0;
-  const unsigned int RndSeed = std::random_device{}();
-  std::mt19937 rnd;
+  // statistics, see register_counters
+  uint64_t rob_full_stalls = 0;
+  uint64_t rs_full_stalls = 0;
+  uint64_t lsq_full_stalls = 0;
+  uint64_t jalr_fetch_stalls = 0;
+  uint64_t committed_alu = 0;
+  uint64_t committed_branches = 0;
+  uint64_t committed_jumps = 0;
+  uint64_t committed_loads = 0;
+  uint64_t committed_stores = 0;
+  // no work() runs while fetching waits for a jalr, so the stall is measured by the clock
+  bool jalr_stalled = false;
+  uint64_t jalr_stall_begin = 0;
+  void EndJalrStall() {
+    if (jalr_stalled) jalr_fetch_stalls += clock() - jalr_stall_begin;
+    jalr_stalled = false;
+  }
+  template <typename Fn>
+  void ForEachCounter(Fn &&fn) {
+    fn("csu.branch_predictions", total_predictions);
+    fn("csu.flushes", incorrect_predictions);  // every misprediction flushes the pipeline
+    fn("csu.rob_full_stalls", rob_full_stalls);
+    fn("csu.rs_full_stalls", rs_full_stalls);
+    fn("csu.lsq_full_stalls", lsq_full_stalls);
+    fn("csu.jalr_fetch_stalls", jalr_fetch_stalls);
+    fn("csu.committed_alu", committed_alu);
+    fn("csu.committed_branches", committed_branches);
+    fn("csu.committed_jumps", committed_jumps);
+    fn("csu.committed_loads", committed_loads);
+    fn("csu.committed_stores", committed_stores);
+  }
   inline void WriteBit(uint32_t &data, int pos, uint8_t bit) {
     data &= ~(1 << pos);
     data |= bit << pos;
@@ -207,12 +238,36 @@ struct CentralScheduleUnit
   }
 
  public:
-  CentralScheduleUnit() : rnd(RndSeed) { ; }
+  CentralScheduleUnit() { ; }
+  void save_state(std::ostream &out) override final {
+    ForEachCounter([&out](const char *, auto &counter) { dark::checkpoint::write_uint(out, counter, 8); });
+    dark::checkpoint::write_uint(out, jalr_stalled, 1);
+    dark::checkpoint::write_uint(out, jalr_stall_begin, 8);
+  }
+  void load_state(std::istream &in) override final {
+    ForEachCounter([&in](const char *, auto &counter) { counter = dark::checkpoint::read_uint(in, 8); });
+    jalr_stalled = dark::checkpoint::read_uint(in, 1);
+    jalr_stall_begin = dark::checkpoint::read_uint(in, 8);
+  }
+  void register_counters(dark::CounterRegistry &registry) override final {
+    ForEachCounter([&registry](const char *name, auto &counter) { registry.add(name, counter); });
+  }
+  // print the prediction statistics to std::cerr when halting
+  bool report_predictions = true;
+  // for progress reports
+  uint64_t CommittedInstructions() const {
+    return committed_alu + committed_branches + committed_jumps + committed_loads + committed_stores;
+  }
+  max_size_t CommittedPC() const { return static_cast<max_size_t>(actual_PC); }
   void SetInstructionFetcher(std::function<max_size_t(max_size_t)> fetcher) {
     if (instruction_fetcher_initialized) throw std::runtime_error("Instruction fetcher has been initialized");
     instruction_fetcher = fetcher;
     instruction_fetcher_initialized = true;
   }
+  bool idle() const override final {
+    // while stalled, no instruction is fetched from the memory
+    return !bool(has_predicted_PC);
+  }
   void work() override final {
     if (bool(reset)) {
       predicted_PC <= 0;
@@ -222,22 +277,24 @@ struct CentralScheduleUnit
       ROB_tail <= 0;
       ROB_remain_space <= kROBSize;
       for (auto &record : ROB_records) {
-        record.state <= 0;
-        record.PC_mismatch_mark <= 0;
+        record.state() <= 0;
+        record.PC_mismatch_mark() <= 0;
       }
       has_instruction_issued_last_cycle <= 0;
       is_issuing <= 0;
       is_committing <= 0;
+      jalr_stalled = false;
       return;
     }
     if (bool(force_clear_announcer)) {
+      EndJalrStall();
       force_clear_announcer <= 0;
       ROB_head <= 0;
       ROB_tail <= 0;
       ROB_remain_space <= kROBSize;
       for (auto &record : ROB_records) {
-        record.state <= 0;
-        record.PC_mismatch_mark <= 0;
+        record.state() <= 0;
+        record.PC_mismatch_mark() <= 0;
       }
       predicted_PC <= actual_PC;
       has_predicted_PC <= 1;
@@ -252,32 +309,47 @@ struct CentralScheduleUnit
     {
       uint32_t i = static_cast<max_size_t>(ROB_head);
       auto &record = ROB_records[i];
-      if (static_cast<max_size_t>(record.state) == 3) {
+      if (static_cast<max_size_t>(record.state()) == 3) {
         ROB_head <= (static_cast<max_size_t>(ROB_head) + 1) % kROBSize;
         DEBUG_CERR << "csu is committing instruct " << std::hex << std::setw(8) << std::setfill('0') << std::uppercase
                    << static_cast<max_size_t>(record.instruction) << std::endl;
         is_committing <= 1;
         has_committed = true;
-        commit_has_resulting_register <= record.has_resulting_register;
-        commit_reg_index <= record.resulting_register_idx;
+        switch (static_cast<max_size_t>(record.instruction) & 0x7F) {
+          case 0b0000011: committed_loads++; break;
+          case 0b0100011: committed_stores++; break;
+          case 0b1100011: committed_branches++; break;
+          case 0b1101111:
+          case 0b1100111: committed_jumps++; break;
+          default: committed_alu++; break;
+        }
+        dark::trace::emit(kTraceCommit, clock(), static_cast<max_size_t>(record.instruction),
+                          bool(record.has_resulting_register()) ? static_cast<max_size_t>(record.resulting_register_idx()) : 0,
+                          static_cast<max_size_t>(record.resulting_register_value));
+        commit_has_resulting_register <= record.has_resulting_register();
+        commit_reg_index <= record.resulting_register_idx();
         commit_reg_value <= record.resulting_register_value;
         DEBUG_CERR << "commit_reg_index=" << std::dec << commit_reg_index.peek() << " commit_reg_value=" << std::hex
                    << std::setw(8) << std::setfill('0') << std::uppercase << commit_reg_value.peek() << std::endl;
         commit_ins_ROB_index <= i;
         actual_PC <= static_cast<max_size_t>(record.resulting_PC);
-        if (static_cast<max_size_t>(record.PC_mismatch_mark) == 1) {
+        if (static_cast<max_size_t>(record.PC_mismatch_mark()) == 1) {
           force_clear_announcer <= 1;
           DEBUG_CERR << "[warning] csu is announcing rolling back due to PC mismatch" << std::endl;
+          dark::trace::emit(kTraceFlush, clock(), static_cast<max_size_t>(record.instruction),
+                            static_cast<max_size_t>(record.resulting_PC), i);
           incorrect_predictions++;
         }
         ROB_next_remain_space++;
         if (record.instruction == 0x0ff00513) {
           halt_signal <= (0b100000000 | static_cast<max_size_t>(a0));
           DEBUG_CERR << "halting with code " << std::dec << int(halt_signal.peek()) << std::endl;
-          std::cerr << "Total predictions: " << total_predictions << std::endl;
-          std::cerr << "Incorrect predictions: " << incorrect_predictions << std::endl;
-          std::cerr << "Prediction rate: " << (1.0 - static_cast<double>(incorrect_predictions) / total_predictions)
-                    << std::endl;
+          if (report_predictions) {
+            std::cerr << "Total predictions: " << total_predictions << std::endl;
+            std::cerr << "Incorrect predictions: " << incorrect_predictions << std::endl;
+            std::cerr << "Prediction rate: " << (1.0 - static_cast<double>(incorrect_predictions) / total_predictions)
+                      << std::endl;
+          }
         }
       }
     }
@@ -291,24 +363,25 @@ struct CentralScheduleUnit
       uint32_t i = -1;
       for (auto &record : ROB_records) {
         ++i;
-        if (static_cast<max_size_t>(record.state) != 2) continue;
+        if (static_cast<max_size_t>(record.state()) != 2) continue;
         if (i == res_ROB_index) {
           record.resulting_register_value <= res_data;
-          if (!bool(record.resulting_PC_ready)) {
+          if (!bool(record.resulting_PC_ready())) {
             record.resulting_PC <= res_PC;
             if (res_PC != static_cast<max_size_t>(record.resulting_PC) &&
                 (static_cast<max_size_t>(record.instruction) & 0x7F) != 0b1100111) {
-              record.PC_mismatch_mark <= 1;
+              record.PC_mismatch_mark() <= 1;
             }
-            record.resulting_PC_ready <= 1;
+            record.resulting_PC_ready() <= 1;
             if ((static_cast<max_size_t>(record.instruction) & 0x7F) == 0b1100111) {
               has_predicted_PC <= 1;
               predicted_PC <= res_PC;
+              EndJalrStall();
               DEBUG_CERR << "The jalr instruction is committed, now predicted_PC is " << std::hex << std::setw(8)
                          << std::setfill('0') << std::uppercase << predicted_PC.peek() << std::endl;
             }
           }
-          record.state <= 3;
+          record.state() <= 3;
           DEBUG_CERR << "result collecting for instruct " << std::hex << std::setw(8) << std::setfill('0')
                      << std::uppercase << static_cast<max_size_t>(record.instruction) << " with ROB_index=" << std::dec
                      << i << std::endl;
@@ -352,16 +425,17 @@ struct CentralScheduleUnit
           is_issuing <= 1;
           has_instruction_issued_last_cycle <= 1;
           uint32_t tail = static_cast<max_size_t>(ROB_tail);
+          dark::trace::emit(kTraceIssue, clock(), static_cast<max_size_t>(predicted_PC), instruction, tail);
           ROB_tail <= (tail + 1) % kROBSize;
           ROB_next_remain_space--;
           predicted_PC <= static_cast<max_size_t>(predicted_PC) + 4;
-          ROB_records[tail].state <= 1;
+          ROB_records[tail].state() <= 1;
           ROB_records[tail].instruction <= instruction;
-          ROB_records[tail].has_resulting_register <= has_decoded_rd;
-          ROB_records[tail].resulting_register_idx <= decoded_rd;
-          ROB_records[tail].resulting_PC_ready <= 1;
+          ROB_records[tail].has_resulting_register() <= has_decoded_rd;
+          ROB_records[tail].resulting_register_idx() <= decoded_rd;
+          ROB_records[tail].resulting_PC_ready() <= 1;
           ROB_records[tail].resulting_PC <= static_cast<max_size_t>(predicted_PC) + 4;
-          ROB_records[tail].PC_mismatch_mark <= 0;
+          ROB_records[tail].PC_mismatch_mark() <= 0;
           this->issue_type <= 1;
           this->issue_ROB_index <= tail;
           this->full_ins_id <= full_ins_id;
@@ -378,6 +452,11 @@ struct CentralScheduleUnit
         } else {
           has_instruction_issued_last_cycle <= 0;
           is_issuing <= 0;
+          if (ROB_next_remain_space > 4) {
+            lsq_full_stalls++;
+          } else {
+            rob_full_stalls++;
+          }
         }
       } else {
         // alu instruction
@@ -392,29 +471,32 @@ struct CentralScheduleUnit
           is_issuing <= 1;
           has_instruction_issued_last_cycle <= 1;
           uint32_t tail = static_cast<max_size_t>(ROB_tail);
+          dark::trace::emit(kTraceIssue, clock(), static_cast<max_size_t>(predicted_PC), instruction, tail);
           ROB_tail <= (tail + 1) % kROBSize;
           ROB_next_remain_space--;
-          ROB_records[tail].state <= 1;
+          ROB_records[tail].state() <= 1;
           ROB_records[tail].instruction <= instruction;
-          ROB_records[tail].has_resulting_register <= has_decoded_rd;
-          ROB_records[tail].resulting_register_idx <= decoded_rd;
+          ROB_records[tail].has_resulting_register() <= has_decoded_rd;
+          ROB_records[tail].resulting_register_idx() <= decoded_rd;
           if ((full_ins_id & 0x7F) == 0b1100011 || ((full_ins_id & 0x7F) == 0b1100111) ||
               ((full_ins_id & 0x7F) == 0b1101111)) {
             switch (full_ins_id & 0x7F) {
               case 0b1101111:
                 // jal
-                ROB_records[tail].resulting_PC_ready <= 1;
+                ROB_records[tail].resulting_PC_ready() <= 1;
                 ROB_records[tail].resulting_PC <= static_cast<max_size_t>(predicted_PC) + decoded_imm;
                 break;
               case 0b1100111:
                 // jalr
                 DEBUG_CERR << "encounter jalr" << std::endl;
-                ROB_records[tail].resulting_PC_ready <= 0;
+                ROB_records[tail].resulting_PC_ready() <= 0;
                 has_predicted_PC <= 0;
+                jalr_stalled = true;
+                jalr_stall_begin = clock();
                 break;
               case 0b1100011:
                 // branch
-                ROB_records[tail].resulting_PC_ready <= 0;
+                ROB_records[tail].resulting_PC_ready() <= 0;
                 if (decoded_imm >> 31) {  // this may be a long jump
                   ROB_records[tail].resulting_PC <= static_cast<max_size_t>(predicted_PC) + decoded_imm;  // just guess
                 } else {
@@ -426,11 +508,11 @@ struct CentralScheduleUnit
                 break;
             }
           } else {
-            ROB_records[tail].resulting_PC_ready <= 1;
+            ROB_records[tail].resulting_PC_ready() <= 1;
             ROB_records[tail].resulting_PC <= static_cast<max_size_t>(predicted_PC) + 4;
           }
           predicted_PC <= ROB_records[tail].resulting_PC.peek();
-          ROB_records[tail].PC_mismatch_mark <= 0;
+          ROB_records[tail].PC_mismatch_mark() <= 0;
           this->issue_type <= 0;
           this->issue_ROB_index <= tail;
           if (instruction == 0x0ff00513) {
@@ -451,6 +533,11 @@ struct CentralScheduleUnit
         } else {
           has_instruction_issued_last_cycle <= 0;
           is_issuing <= 0;
+          if (ROB_next_remain_space > 0) {
+            rs_full_stalls++;
+          } else {
+            rob_full_stalls++;
+          }
         }
       }
     } else {
@@ -462,38 +549,38 @@ struct CentralScheduleUnit
       DEBUG_CERR << "CSU is processing potentially missing data for instruction issued last cycle" << std::endl;
       uint8_t rs1 = static_cast<max_size_t>(this->decoded_rs1);
       uint8_t found_rs1 = 0;
-      uint32_t rs1_v;
+      uint32_t rs1_v = 0;
       uint8_t rs2 = static_cast<max_size_t>(this->decoded_rs2);
       uint8_t found_rs2 = 0;
-      uint32_t rs2_v;
+      uint32_t rs2_v = 0;
       uint32_t ptr = static_cast<max_size_t>(ROB_head);
       dark::debug::assert(static_cast<max_size_t>(ROB_remain_space) < 32, "ROB is empty");
       do {
         DEBUG_CERR << "\tptr=" << std::dec << ptr << std::endl;
-        if (ROB_records[ptr].state.peek() == 3) {
+        if (ROB_records[ptr].state().peek() == 3) {
           DEBUG_CERR << "\tstatus check passed" << std::endl;
-          if (bool(ROB_records[ptr].has_resulting_register) &&
-              static_cast<max_size_t>(ROB_records[ptr].resulting_register_idx) == rs1) {
+          if (bool(ROB_records[ptr].has_resulting_register()) &&
+              static_cast<max_size_t>(ROB_records[ptr].resulting_register_idx()) == rs1) {
             rs1_v = ROB_records[ptr].resulting_register_value.peek();
             found_rs1 = 1;
             DEBUG_CERR << "\tmatching rs1=" << std::dec << int(rs1) << " ptr=" << std::dec << ptr
                        << " rs1_v=" << std::hex << std::setw(8) << std::setfill('0') << rs1_v << std::endl;
           }
-          if (bool(ROB_records[ptr].has_resulting_register) &&
-              static_cast<max_size_t>(ROB_records[ptr].resulting_register_idx) == rs2) {
+          if (bool(ROB_records[ptr].has_resulting_register()) &&
+              static_cast<max_size_t>(ROB_records[ptr].resulting_register_idx()) == rs2) {
             rs2_v = ROB_records[ptr].resulting_register_value.peek();
             found_rs2 = 1;
             DEBUG_CERR << "\tmatching rs2=" << std::dec << int(rs2) << " ptr=" << std::dec << ptr
                        << " rs2_v=" << std::hex << std::setw(8) << std::setfill('0') << rs2_v << std::endl;
           }
         } else {
-          if (bool(ROB_records[ptr].has_resulting_register) &&
-              static_cast<max_size_t>(ROB_records[ptr].resulting_register_idx) == rs1) {
+          if (bool(ROB_records[ptr].has_resulting_register()) &&
+              static_cast<max_size_t>(ROB_records[ptr].resulting_register_idx()) == rs1) {
             found_rs1 = 0;
             DEBUG_CERR << "\tdematching rs1=" << std::dec << int(rs1) << " ptr=" << std::dec << ptr << std::endl;
           }
-          if (bool(ROB_records[ptr].has_resulting_register) &&
-              static_cast<max_size_t>(ROB_records[ptr].resulting_register_idx) == rs2) {
+          if (bool(ROB_records[ptr].has_resulting_register()) &&
+              static_cast<max_size_t>(ROB_records[ptr].resulting_register_idx()) == rs2) {
             found_rs2 = 0;
             DEBUG_CERR << "\tdematching rs2=" << std::dec << int(rs2) << " ptr=" << std::dec << ptr << std::endl;
           }
@@ -508,8 +595,8 @@ struct CentralScheduleUnit
     // other data
     ROB_remain_space <= ROB_next_remain_space;
     for (auto &record : ROB_records) {
-      if (static_cast<max_size_t>(record.state) == 1) {
-        record.state <= 2;
+      if (static_cast<max_size_t>(record.state()) == 1) {
+        record.state() <= 2;
       }
     }
   }
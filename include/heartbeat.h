@@ -0,0 +1,101 @@
+#pragma once
+#include "concept.h"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace dark {
+
+/**
+ * Periodic report of how fast the host simulates, see CPU::set_heartbeat.
+ * The wall clock is only read every kStride cycles, and a line is written once the interval passed:
+ * elapsed time, cycles, cycles/s, instructions/s and IPC over the interval, and the PC.
+ * With a floor, a runtime_error is thrown when an interval runs fewer cycles per second.
+ * Without reporting, the heartbeat only checks the floor and writes nothing.
+ */
+class Heartbeat {
+public:
+	using Clock = std::chrono::steady_clock;
+	static constexpr unsigned long long kStride = 1 << 14;
+
+private:
+	std::ostream &_M_out;
+	const Clock::duration _M_interval;
+	const double _M_floor;
+	bool _M_reporting = true;
+	std::function<std::uint64_t()> _M_instructions;
+	std::function<max_size_t()> _M_pc;
+
+	Clock::time_point _M_start;
+	Clock::time_point _M_last_time;
+	unsigned long long _M_last_cycles = 0;
+	std::uint64_t _M_last_instructions = 0;
+
+	std::uint64_t _M_read_instructions() const { return this->_M_instructions ? this->_M_instructions() : 0; }
+
+public:
+	Heartbeat(std::ostream &out, double interval_seconds, double min_cycles_per_second = 0)
+		: _M_out(out),
+		  _M_interval(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(interval_seconds))),
+		  _M_floor(min_cycles_per_second) {
+		if (!(interval_seconds > 0))
+			throw std::invalid_argument("Heartbeat: the interval must be positive.");
+	}
+
+	/* Where the committed instructions come from, e.g. a counter of the registry. */
+	void set_instructions(std::function<std::uint64_t()> fn) { this->_M_instructions = std::move(fn); }
+	void set_pc(std::function<max_size_t()> fn) { this->_M_pc = std::move(fn); }
+	void set_reporting(bool enable) { this->_M_reporting = enable; }
+
+	/* Start measuring from the given cycle, return the first cycle to poll at. */
+	unsigned long long start(unsigned long long cycles) {
+		this->_M_start = this->_M_last_time = Clock::now();
+		this->_M_last_cycles = cycles;
+		this->_M_last_instructions = this->_M_read_instructions();
+		return cycles + kStride;
+	}
+
+	/* Report if the interval passed, return the next cycle to poll at. */
+	unsigned long long poll(unsigned long long cycles) {
+		const auto now = Clock::now();
+		if (now - this->_M_last_time < this->_M_interval) return cycles + kStride;
+
+		const double seconds = std::chrono::duration<double>(now - this->_M_last_time).count();
+		const auto instructions = this->_M_read_instructions();
+		const auto delta_cycles = cycles - this->_M_last_cycles;
+		const auto delta_instructions = instructions - this->_M_last_instructions;
+		const double speed = delta_cycles / seconds;
+
+		if (this->_M_reporting) {
+			std::ostringstream line;
+			line << std::fixed << std::setprecision(1)
+				 << "[heartbeat] " << std::chrono::duration<double>(now - this->_M_start).count() << " s"
+				 << "  cycles " << cycles
+				 << "  " << speed / 1e6 << " Mcycles/s"
+				 << "  " << delta_instructions / seconds / 1e6 << " Minsts/s"
+				 << std::setprecision(3)
+				 << "  IPC " << (delta_cycles == 0 ? 0.0 : double(delta_instructions) / delta_cycles);
+			if (this->_M_pc)
+				line << "  PC " << std::hex << std::setw(8) << std::setfill('0') << this->_M_pc();
+			line << '\n';
+			this->_M_out << line.str() << std::flush;
+		}
+
+		this->_M_last_time = now;
+		this->_M_last_cycles = cycles;
+		this->_M_last_instructions = instructions;
+		if (speed < this->_M_floor) {
+			std::ostringstream what;
+			what << "Heartbeat: " << speed << " cycles/s is below the floor of " << this->_M_floor << '.';
+			throw std::runtime_error(what.str());
+		}
+		return cycles + kStride;
+	}
+};
+
+} // namespace dark
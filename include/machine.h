@@ -0,0 +1,186 @@
+#pragma once
+#include "concept.h"
+#ifndef MACHINE_H
+#include "alu.h"
+#include "csu.h"
+#include "loadstorequeue.h"
+#include "memory.h"
+#include "netlist.h"
+#include "registerfile.h"
+#include "reservestation.h"
+#include "tools.h"
+namespace ZYM {
+using dark::Connect;
+// the connections between the modules, see the comment and docs for help
+using MachineNetlist = dark::Netlist<
+    // csu <-> memory
+    Connect<&CentralScheduleUnit::force_clear_announcer, &Memory::force_clear_receiver>,
+    Connect<&CentralScheduleUnit::is_committing, &Memory::is_committing>,
+    Connect<&CentralScheduleUnit::commit_ins_ROB_index, &Memory::commit_ins_ROB_index>,
+    Connect<&Memory::data_sign, &CentralScheduleUnit::mem_status_receiver>,
+    Connect<&Memory::completed_memins_ROB_index, &CentralScheduleUnit::completed_memins_ROB_index>,
+    Connect<&Memory::completed_memins_read_data, &CentralScheduleUnit::completed_memins_read_data>,
+    // csu <-> lsq
+    Connect<&CentralScheduleUnit::force_clear_announcer, &LoadStoreQueue::force_clear_receiver>,
+    Connect<&CentralScheduleUnit::is_issuing, &LoadStoreQueue::is_issuing>,
+    Connect<&CentralScheduleUnit::issue_type, &LoadStoreQueue::issue_type>,
+    Connect<&CentralScheduleUnit::issue_ROB_index, &LoadStoreQueue::issue_ROB_index>,
+    Connect<&CentralScheduleUnit::full_ins_id, &LoadStoreQueue::full_ins_id>,
+    Connect<&CentralScheduleUnit::full_ins, &LoadStoreQueue::full_ins>,
+    Connect<&CentralScheduleUnit::issuing_PC, &LoadStoreQueue::issuing_PC>,
+    Connect<&CentralScheduleUnit::decoded_rd, &LoadStoreQueue::decoded_rd>,
+    Connect<&CentralScheduleUnit::has_decoded_rd, &LoadStoreQueue::has_decoded_rd>,
+    Connect<&CentralScheduleUnit::decoded_rs1, &LoadStoreQueue::decoded_rs1>,
+    Connect<&CentralScheduleUnit::has_decoded_rs1, &LoadStoreQueue::has_decoded_rs1>,
+    Connect<&CentralScheduleUnit::rs1_is_in_ROB, &LoadStoreQueue::rs1_is_in_ROB>,
+    Connect<&CentralScheduleUnit::rs1_in_ROB_value, &LoadStoreQueue::rs1_in_ROB_value>,
+    Connect<&CentralScheduleUnit::decoded_rs2, &LoadStoreQueue::decoded_rs2>,
+    Connect<&CentralScheduleUnit::has_decoded_rs2, &LoadStoreQueue::has_decoded_rs2>,
+    Connect<&CentralScheduleUnit::rs2_is_in_ROB, &LoadStoreQueue::rs2_is_in_ROB>,
+    Connect<&CentralScheduleUnit::rs2_in_ROB_value, &LoadStoreQueue::rs2_in_ROB_value>,
+    Connect<&CentralScheduleUnit::decoded_imm, &LoadStoreQueue::decoded_imm>,
+    // Connect<&CentralScheduleUnit::cache_hit, &LoadStoreQueue::cache_hit>,
+    // Connect<&CentralScheduleUnit::cache_hit_ROB_index, &LoadStoreQueue::cache_hit_ROB_index>,
+    // Connect<&CentralScheduleUnit::cache_hit_data, &LoadStoreQueue::cache_hit_data>,
+    Connect<&LoadStoreQueue::mem_request_full_ins_id, &CentralScheduleUnit::mem_request_full_ins_id>,
+    Connect<&LoadStoreQueue::request_type_output, &CentralScheduleUnit::mem_request_type_input>,
+    Connect<&LoadStoreQueue::request_ROB_index, &CentralScheduleUnit::mem_request_ROB_index>,
+    Connect<&LoadStoreQueue::request_address_output, &CentralScheduleUnit::mem_address_input>,
+    Connect<&LoadStoreQueue::request_data_output, &CentralScheduleUnit::mem_data_input>,
+    Connect<&LoadStoreQueue::LSQ_remain_space_output, &CentralScheduleUnit::load_store_queue_emptyspace_receiver>,
+    // csu <-> alu
+    Connect<&ALU::alu_status, &CentralScheduleUnit::alu_status_receiver>,
+    Connect<&ALU::result_ROB_index, &CentralScheduleUnit::completed_aluins_ROB_index>,
+    Connect<&ALU::result, &CentralScheduleUnit::completed_aluins_result>,
+    Connect<&ALU::completed_alu_resulting_PC, &CentralScheduleUnit::completed_alu_resulting_PC>,
+    // csu <-> register file
+    Connect<&CentralScheduleUnit::force_clear_announcer, &RegisterFile::force_clear_receiver>,
+    Connect<&CentralScheduleUnit::is_issuing, &RegisterFile::is_issuing>,
+    Connect<&CentralScheduleUnit::issue_type, &RegisterFile::issue_type>,
+    Connect<&CentralScheduleUnit::issue_ROB_index, &RegisterFile::issue_ROB_index>,
+    Connect<&CentralScheduleUnit::full_ins_id, &RegisterFile::full_ins_id>,
+    Connect<&CentralScheduleUnit::full_ins, &RegisterFile::full_ins>,
+    Connect<&CentralScheduleUnit::decoded_rd, &RegisterFile::decoded_rd>,
+    Connect<&CentralScheduleUnit::has_decoded_rd, &RegisterFile::has_decoded_rd>,
+    Connect<&CentralScheduleUnit::decoded_rs1, &RegisterFile::decoded_rs1>,
+    Connect<&CentralScheduleUnit::has_decoded_rs1, &RegisterFile::has_decoded_rs1>,
+    Connect<&CentralScheduleUnit::decoded_rs2, &RegisterFile::decoded_rs2>,
+    Connect<&CentralScheduleUnit::has_decoded_rs2, &RegisterFile::has_decoded_rs2>,
+    // Connect<&RegisterFile::rs1_nodep, &CentralScheduleUnit::rs1_nodep>,
+    // Connect<&RegisterFile::rs1_deps, &CentralScheduleUnit::rs1_deps>,
+    // Connect<&RegisterFile::rs2_nodep, &CentralScheduleUnit::rs2_nodep>,
+    // Connect<&RegisterFile::rs2_deps, &CentralScheduleUnit::rs2_deps>,
+    Connect<&CentralScheduleUnit::is_committing, &RegisterFile::is_committing>,
+    Connect<&CentralScheduleUnit::commit_has_resulting_register, &RegisterFile::has_resulting_register>,
+    Connect<&CentralScheduleUnit::commit_reg_index, &RegisterFile::commit_reg_index>,
+    Connect<&CentralScheduleUnit::commit_reg_value, &RegisterFile::commit_reg_value>,
+    Connect<&CentralScheduleUnit::commit_ins_ROB_index, &RegisterFile::commit_ins_ROB_index>,
+    // csu <-> reserve station
+    Connect<&CentralScheduleUnit::force_clear_announcer, &ReserveStation::force_clear_receiver>,
+    Connect<&CentralScheduleUnit::is_issuing, &ReserveStation::is_issuing>,
+    Connect<&CentralScheduleUnit::issue_type, &ReserveStation::issue_type>,
+    Connect<&CentralScheduleUnit::issue_ROB_index, &ReserveStation::issue_ROB_index>,
+    Connect<&CentralScheduleUnit::full_ins_id, &ReserveStation::full_ins_id>,
+    Connect<&CentralScheduleUnit::full_ins, &ReserveStation::full_ins>,
+    Connect<&CentralScheduleUnit::issuing_PC, &ReserveStation::issuing_PC>,
+    Connect<&CentralScheduleUnit::decoded_rd, &ReserveStation::decoded_rd>,
+    Connect<&CentralScheduleUnit::has_decoded_rd, &ReserveStation::has_decoded_rd>,
+    Connect<&CentralScheduleUnit::decoded_rs1, &ReserveStation::decoded_rs1>,
+    Connect<&CentralScheduleUnit::has_decoded_rs1, &ReserveStation::has_decoded_rs1>,
+    Connect<&CentralScheduleUnit::rs1_is_in_ROB, &ReserveStation::rs1_is_in_ROB>,
+    Connect<&CentralScheduleUnit::rs1_in_ROB_value, &ReserveStation::rs1_in_ROB_value>,
+    Connect<&CentralScheduleUnit::decoded_rs2, &ReserveStation::decoded_rs2>,
+    Connect<&CentralScheduleUnit::has_decoded_rs2, &ReserveStation::has_decoded_rs2>,
+    Connect<&CentralScheduleUnit::rs2_is_in_ROB, &ReserveStation::rs2_is_in_ROB>,
+    Connect<&CentralScheduleUnit::rs2_in_ROB_value, &ReserveStation::rs2_in_ROB_value>,
+    Connect<&CentralScheduleUnit::decoded_imm, &ReserveStation::decoded_imm>,
+    Connect<&CentralScheduleUnit::decoded_shamt, &ReserveStation::decoded_shamt>,
+    // Connect<&CentralScheduleUnit::cache_hit, &ReserveStation::cache_hit>,
+    // Connect<&CentralScheduleUnit::cache_hit_ROB_index, &ReserveStation::cache_hit_ROB_index>,
+    // Connect<&CentralScheduleUnit::cache_hit_data, &ReserveStation::cache_hit_data>,
+    Connect<&ReserveStation::RS_remain_space_output, &CentralScheduleUnit::reservestation_emptyspace_receiver>,
+    // memory <-> lsq
+    Connect<&Memory::data_sign, &LoadStoreQueue::mem_data_sign>,
+    Connect<&Memory::completed_memins_ROB_index, &LoadStoreQueue::completed_memins_ROB_index>,
+    Connect<&Memory::completed_memins_read_data, &LoadStoreQueue::completed_memins_read_data>,
+    Connect<&LoadStoreQueue::mem_request_full_ins_id, &Memory::full_ins_id>,
+    Connect<&LoadStoreQueue::request_type_output, &Memory::request_type_input>,
+    Connect<&LoadStoreQueue::request_ROB_index, &Memory::request_ROB_index>,
+    Connect<&LoadStoreQueue::request_address_output, &Memory::address_input>,
+    Connect<&LoadStoreQueue::request_data_output, &Memory::data_input>,
+    // memory <-> alu : no connections
+    // memory <-> register file : no connections
+    // memory <-> reserve station :
+    Connect<&Memory::data_sign, &ReserveStation::mem_status_receiver>,
+    Connect<&Memory::completed_memins_ROB_index, &ReserveStation::completed_memins_ROB_index>,
+    Connect<&Memory::completed_memins_read_data, &ReserveStation::completed_memins_read_data>,
+    // lsq <-> alu :
+    Connect<&ALU::alu_status, &LoadStoreQueue::alu_status_receiver>,
+    Connect<&ALU::result_ROB_index, &LoadStoreQueue::completed_aluins_ROB_index>,
+    Connect<&ALU::result, &LoadStoreQueue::completed_aluins_result>,
+    // lsq <-> register file
+    Connect<&RegisterFile::rs1_nodep, &LoadStoreQueue::rs1_nodep>,
+    Connect<&RegisterFile::rs1_deps, &LoadStoreQueue::rs1_deps>,
+    Connect<&RegisterFile::rs1_value, &LoadStoreQueue::rs1_value>,
+    Connect<&RegisterFile::rs2_nodep, &LoadStoreQueue::rs2_nodep>,
+    Connect<&RegisterFile::rs2_deps, &LoadStoreQueue::rs2_deps>,
+    Connect<&RegisterFile::rs2_value, &LoadStoreQueue::rs2_value>,
+    // lsq <-> reserve station : no connections
+    // alu <-> register file : no connections
+    // alu <-> reserve station
+    Connect<&ReserveStation::request_full_id, &ALU::request_full_id>,
+    Connect<&ReserveStation::operand1, &ALU::operand1>,
+    Connect<&ReserveStation::operand2, &ALU::operand2>,
+    Connect<&ReserveStation::request_ROB_index, &ALU::request_ROB_index>,
+    Connect<&ReserveStation::alu_ins_PC, &ALU::request_PC>,
+    Connect<&ReserveStation::op_imm, &ALU::imm>,
+    Connect<&ReserveStation::op_shamt, &ALU::shamt>,
+    Connect<&ALU::alu_status, &ReserveStation::alu_status_receiver>,
+    Connect<&ALU::result_ROB_index, &ReserveStation::completed_aluins_ROB_index>,
+    Connect<&ALU::result, &ReserveStation::completed_aluins_result>,
+    // register file <-> reserve station
+    Connect<&RegisterFile::rs1_nodep, &ReserveStation::rs1_nodep>,
+    Connect<&RegisterFile::rs1_deps, &ReserveStation::rs1_deps>,
+    Connect<&RegisterFile::rs1_value, &ReserveStation::rs1_value>,
+    Connect<&RegisterFile::rs2_nodep, &ReserveStation::rs2_nodep>,
+    Connect<&RegisterFile::rs2_deps, &ReserveStation::rs2_deps>,
+    Connect<&RegisterFile::rs2_value, &ReserveStation::rs2_value>
+    >;
+// the whole processor, with its modules added to cpu and wired together
+// a machine owns all of its state, so several of them may run in different threads
+template <typename CPUType>
+struct BasicMachine {
+  CPUType cpu;
+  CentralScheduleUnit csu;
+  Memory memory;
+  LoadStoreQueue lsq;
+  ALU alu;
+  RegisterFile rf;
+  ReserveStation rs;
+  BasicMachine() {
+    cpu.add_module(&csu);
+    cpu.add_module(&memory);
+    cpu.add_module(&lsq);
+    cpu.add_module(&alu);
+    cpu.add_module(&rf);
+    cpu.add_module(&rs);
+    // some basic siganls
+    cpu.halt_signal.assign(csu.halt_signal);
+    csu.SetInstructionFetcher([&](auto addr) { return memory.FetchInstruction(addr); });
+    csu.reset.assign([&]() { return cpu.GetResetSignal(); });
+    memory.reset.assign([&]() { return cpu.GetResetSignal(); });
+    lsq.reset.assign([&]() { return cpu.GetResetSignal(); });
+    // alu.reset.assign([&]() { return cpu.GetResetSignal(); });
+    rf.reset.assign([&]() { return cpu.GetResetSignal(); });
+    rs.reset.assign([&]() { return cpu.GetResetSignal(); });
+    csu.a0.assign([&]() { return rf.ReturnExitCodeImmediately(); });
+    // now connect the wires, see MachineNetlist above
+    MachineNetlist::apply(csu, memory, lsq, alu, rf, rs);
+  }
+};
+using Machine = BasicMachine<dark::CPU>;
+// work() of every module is called without virtual dispatch, but only the plain run mode is available
+using StaticMachine = BasicMachine<
+    dark::StaticCPU<CentralScheduleUnit, Memory, LoadStoreQueue, ALU, RegisterFile, ReserveStation>>;
+}  // namespace ZYM
+#endif
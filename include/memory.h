@@ -2,11 +2,13 @@
 #include <cstddef>
 #include "concept.h"
 #ifndef MEMORY_H
+#include <algorithm>
 #include <cstdint>
 #include <ios>
 #include <set>
 #include <vector>
 #include "tools.h"
+#include "traceevents.h"
 using dark::max_size_t;
 namespace ZYM {
 struct Memory_Input {
@@ -47,6 +49,32 @@ struct Memory_Private {
 struct Memory : dark::Module<Memory_Input, Memory_Output, Memory_Private> {
  private:
   std::vector<uint8_t> memory_data;
+  // statistics, see register_counters
+  uint64_t busy_cycles = 0;
+  uint64_t reads = 0;
+  uint64_t writes = 0;
+  // incremental hash of memory_data, see hash_state: the hash of each page, mixed into one
+  static constexpr size_t kHashPage = 4096;
+  std::vector<uint64_t> page_hashes;
+  std::vector<uint32_t> dirty_pages;
+  std::vector<bool> page_dirty;
+  uint64_t memory_hash = 0;
+  void TouchPages(size_t addr, size_t len) {
+    if (page_dirty.empty()) return;  // not hashed yet, all pages are hashed the first time
+    for (size_t page = addr / kHashPage; page <= (addr + len - 1) / kHashPage; page++) {
+      if (!page_dirty[page]) {
+        page_dirty[page] = true;
+        dirty_pages.push_back(page);
+      }
+    }
+  }
+  uint64_t PageHash(size_t page) const {
+    size_t begin = page * kHashPage;
+    dark::StateHash h;
+    h.add(page);
+    h.add_bytes(memory_data.data() + begin, std::min(kHashPage, memory_data.size() - begin));
+    return h.value();
+  }
   void Undo() {
     std::set<std::pair<uint32_t, std::pair<uint32_t, uint8_t>>> undo_list;  // (timestamp, (addr, before))
     for (int i = 0; i < 32; i++) {
@@ -65,11 +93,21 @@ struct Memory : dark::Module<Memory_Input, Memory_Output, Memory_Private> {
     for (int i = 0; i < sz; i++) {
       it--;
       memory_data[it->second.first] = it->second.second;
+      TouchPages(it->second.first, 1);
     }
   }
 
  public:
   Memory() { memory_data.resize(1 << 20, 0); }
+  bool idle() const override final {
+    // only a pending write or a rollback touches memory_data
+    return max_size_t(status) == 0 && !bool(force_clear_receiver);
+  }
+  void register_counters(dark::CounterRegistry &registry) override final {
+    registry.add("memory.busy_cycles", busy_cycles);
+    registry.add("memory.reads", reads);
+    registry.add("memory.writes", writes);
+  }
   void work() override final {
     if (bool(reset)) {
       // do some initialization
@@ -90,14 +128,18 @@ struct Memory : dark::Module<Memory_Input, Memory_Output, Memory_Private> {
     if (bool(is_committing)) {
       playback[static_cast<max_size_t>(commit_ins_ROB_index)].has_uncommitted_write <= 0;
     }
-    cur_timestamp <= static_cast<max_size_t>(cur_timestamp) + 1;
     max_size_t request_type_signal = max_size_t(request_type_input);
     uint8_t rw_type = request_type_signal & 3;           // 0b00->none,0b01->read,0b10->write,0b11->invalid
     uint8_t opt_bytes = (request_type_signal >> 2) & 3;  // 0->1, 1->2, 2->4
     if (rw_type == 3) throw std::runtime_error("Invalid request type");
     uint32_t current_status = max_size_t(status);
+    // timestamps only order the writes, so they need not advance while the memory is idle
+    if (current_status > 0 || request_type_signal > 0) {
+      cur_timestamp <= static_cast<max_size_t>(cur_timestamp) + 1;
+    }
     if (current_status > 0) {
       // in working status
+      busy_cycles++;
       if (request_type_signal > 0) throw std::runtime_error("Memory is busy");
       if (current_status == 1) {
         status <= 2;
@@ -142,7 +184,9 @@ struct Memory : dark::Module<Memory_Input, Memory_Output, Memory_Private> {
           default:
             throw std::runtime_error("Invalid bytes");
         }
+        dark::trace::emit(kTraceMemRead, clock(), max_size_t(cur_opt_addr), completed_memins_read_data.peek(), len);
         data_sign <= 2;  // has data and free
+        reads++;
         return;
       } else {
         size_t len = 1 << max_size_t(cur_opt_bytes);
@@ -158,6 +202,7 @@ struct Memory : dark::Module<Memory_Input, Memory_Output, Memory_Private> {
             playback[cur_opt_ROB_index].changes[2].this_byte_changed <= 0;
             playback[cur_opt_ROB_index].changes[3].this_byte_changed <= 0;
             memory_data[max_size_t(cur_opt_addr)] = max_size_t(cur_opt_data) & 0xff;
+            TouchPages(max_size_t(cur_opt_addr), len);
             break;
           case 2:
             playback[cur_opt_ROB_index].has_uncommitted_write <= 1;
@@ -171,6 +216,7 @@ struct Memory : dark::Module<Memory_Input, Memory_Output, Memory_Private> {
             playback[cur_opt_ROB_index].changes[2].this_byte_changed <= 0;
             playback[cur_opt_ROB_index].changes[3].this_byte_changed <= 0;
             *reinterpret_cast<uint16_t *>(&memory_data[max_size_t(cur_opt_addr)]) = max_size_t(cur_opt_data) & 0xffff;
+            TouchPages(max_size_t(cur_opt_addr), len);
             break;
           case 4:
             playback[cur_opt_ROB_index].has_uncommitted_write <= 1;
@@ -188,6 +234,7 @@ struct Memory : dark::Module<Memory_Input, Memory_Output, Memory_Private> {
             playback[cur_opt_ROB_index].changes[3].addr <= cur_opt_addr + 3;
             playback[cur_opt_ROB_index].changes[3].before <= memory_data[max_size_t(cur_opt_addr) + 3];
             *reinterpret_cast<uint32_t *>(&memory_data[max_size_t(cur_opt_addr)]) = max_size_t(cur_opt_data);
+            TouchPages(max_size_t(cur_opt_addr), len);
             DEBUG_CERR << "Memory executing sw, ROB_index=" << std::dec
                       << static_cast<max_size_t>(completed_memins_ROB_index) << std::endl;
             DEBUG_CERR << "\taddr=" << std::hex << std::setfill('0') << std::setw(8)
@@ -198,7 +245,10 @@ struct Memory : dark::Module<Memory_Input, Memory_Output, Memory_Private> {
           default:
             throw std::runtime_error("Invalid bytes");
         }
+        dark::trace::emit(kTraceMemWrite, clock(), max_size_t(cur_opt_addr),
+                          max_size_t(cur_opt_data) & (len == 4 ? 0xffffffffu : (1u << (len * 8)) - 1), len);
         data_sign <= 2;  // free
+        writes++;
         return;
       }
     }
@@ -222,7 +272,66 @@ struct Memory : dark::Module<Memory_Input, Memory_Output, Memory_Private> {
     res = *reinterpret_cast<max_size_t *>(&memory_data[addr]);
     return res;
   }
-  void LoadProgram(std::istream &fin) {
+  // only the pages holding non-zero bytes are saved
+  static constexpr size_t kCheckpointPage = 4096;
+  void save_state(std::ostream &out) override final {
+    std::vector<uint32_t> pages;
+    for (size_t begin = 0; begin < memory_data.size(); begin += kCheckpointPage) {
+      size_t end = std::min(begin + kCheckpointPage, memory_data.size());
+      if (std::any_of(memory_data.begin() + begin, memory_data.begin() + end, [](uint8_t x) { return x != 0; })) {
+        pages.push_back(begin / kCheckpointPage);
+      }
+    }
+    dark::checkpoint::write_uint(out, memory_data.size(), 8);
+    dark::checkpoint::write_uint(out, pages.size(), 8);
+    for (auto page : pages) {
+      size_t begin = page * kCheckpointPage;
+      size_t end = std::min(begin + kCheckpointPage, memory_data.size());
+      dark::checkpoint::write_uint(out, page, 4);
+      dark::checkpoint::write_data(out, memory_data.data() + begin, end - begin);
+    }
+    dark::checkpoint::write_uint(out, busy_cycles, 8);
+    dark::checkpoint::write_uint(out, reads, 8);
+    dark::checkpoint::write_uint(out, writes, 8);
+  }
+  // only the pages written since the last hash are hashed again
+  void hash_state(dark::StateHash &h) override final {
+    if (page_dirty.empty()) {
+      page_hashes.resize((memory_data.size() + kHashPage - 1) / kHashPage);
+      page_dirty.assign(page_hashes.size(), false);
+      memory_hash = 0;
+      for (size_t page = 0; page < page_hashes.size(); page++) {
+        page_hashes[page] = PageHash(page);
+        memory_hash ^= page_hashes[page];
+      }
+    }
+    for (auto page : dirty_pages) {
+      memory_hash ^= page_hashes[page];
+      page_hashes[page] = PageHash(page);
+      memory_hash ^= page_hashes[page];
+      page_dirty[page] = false;
+    }
+    dirty_pages.clear();
+    h.add(memory_hash);
+  }
+  void load_state(std::istream &in) override final {
+    memory_data.assign(dark::checkpoint::read_uint(in, 8), 0);
+    size_t count = dark::checkpoint::read_uint(in, 8);
+    for (size_t i = 0; i < count; i++) {
+      size_t begin = dark::checkpoint::read_uint(in, 4) * kCheckpointPage;
+      if (begin >= memory_data.size()) throw std::runtime_error("Checkpoint: memory page out of range");
+      size_t end = std::min(begin + kCheckpointPage, memory_data.size());
+      dark::checkpoint::read_data(in, memory_data.data() + begin, end - begin);
+    }
+    busy_cycles = dark::checkpoint::read_uint(in, 8);
+    reads = dark::checkpoint::read_uint(in, 8);
+    writes = dark::checkpoint::read_uint(in, 8);
+    page_dirty.clear();
+    dirty_pages.clear();
+  }
+  // parse the program once, so that several memories can load the same image
+  static std::vector<uint8_t> ParseProgram(std::istream &fin) {
+    std::vector<uint8_t> image;
     fin >> std::hex;
     std::string rubbish_bin;
     do {
@@ -236,17 +345,27 @@ struct Memory : dark::Module<Memory_Input, Memory_Output, Memory_Private> {
       while (fin >> tmp) {
         buf.push_back(tmp);
       }
-      if (memory_data.size() < addr + buf.size()) {
-        memory_data.resize(addr + buf.size());
+      if (image.size() < addr + buf.size()) {
+        image.resize(addr + buf.size());
       }
       for (int i = 0; i < buf.size(); i++) {
-        memory_data[addr + i] = buf[i];
+        image[addr + i] = buf[i];
         // DEBUG_CERR << std::hex << addr + i << ' ' << std::uppercase << std::setw(2) << std::setfill('0') << std::hex
         //  << (int)buf[i] << std::endl;
       }
       fin.clear();
     } while (!fin.eof());
+    return image;
+  }
+  void LoadProgram(const std::vector<uint8_t> &image) {
+    if (memory_data.size() < image.size()) {
+      memory_data.resize(image.size());
+    }
+    std::copy(image.begin(), image.end(), memory_data.begin());
+    page_dirty.clear();
+    dirty_pages.clear();
   }
+  void LoadProgram(std::istream &fin) { LoadProgram(ParseProgram(fin)); }
 };
 }  // namespace ZYM
 #endif  // MEMORY_H
\ No newline at end of file
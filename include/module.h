@@ -1,5 +1,9 @@
 #pragma once
+#include "counters.h"
+#include "statehash.h"
 #include "synchronize.h"
+#include "wire.h"
+#include <vector>
 namespace dark {
 
 namespace details {
@@ -8,10 +12,47 @@ namespace details {
 	};
 } // namespace details
 
+class CPU;
+template<typename... _Modules>
+class StaticCPU;
+
 struct ModuleBase {
 	virtual void work() = 0;
 	virtual void sync() = 0;
+	virtual void bind(RegisterBank &) { /* no registers to bind */ }
+	/**
+	 * Whether work() has no effect other than assigning registers from the inputs and registers,
+	 * in the current state. With clock gating, such a module is skipped while nothing it reads changes.
+	 */
+	virtual bool idle() const { return false; }
+	/* Write all registers and the extra state of save_state to a checkpoint, see CPU::save. */
+	virtual void save(std::ostream &out) { this->save_state(out); }
+	virtual void load(std::istream &in) { this->load_state(in); }
+	/* State kept outside of registers, such as a memory array or statistics. */
+	virtual void save_state(std::ostream &) { /* no extra state */ }
+	virtual void load_state(std::istream &) { /* no extra state */ }
+	/* Mix all registers and the extra state of hash_state into a hash, see CPU::state_hash. */
+	virtual void hash(StateHash &h) { this->hash_state(h); }
+	/* State kept outside of registers that decides what the module does, unlike statistics. */
+	virtual void hash_state(StateHash &) { /* no extra state */ }
+	/* Record the values of the connected input wires, and return whether any of them changed. */
+	virtual bool sample_inputs(std::vector<max_size_t> &) { return true; }
+	/* Append every register and connected wire, named by its path in the module structs. */
+	virtual void probe(std::vector<Probe> &) { /* no signals */ }
+	/* Append every lambda wire, named by its path in the module structs. */
+	virtual void collect_wires(std::vector<details::WireNode> &) { /* no wires */ }
+	/* Register the statistics counters of the module, called when it is added to a CPU. */
+	virtual void register_counters(CounterRegistry &) { /* no counters */ }
 	virtual ~ModuleBase() = default;
+
+	/* The clock of the CPU running this module, 0 before it is added to one. */
+	unsigned int clock() const { return this->_M_clock != nullptr ? *this->_M_clock : 0; }
+
+private:
+	friend class CPU;
+	template<typename... _Modules>
+	friend class StaticCPU;
+	const unsigned int *_M_clock = nullptr;
 };
 
 template<typename _Tinput, typename _Toutput, typename _Tprivate = details::empty_class>
@@ -22,6 +63,87 @@ struct Module : public ModuleBase, public _Tinput, public _Toutput, protected _T
 		sync_member(static_cast<_Toutput &>(*this));
 		sync_member(static_cast<_Tprivate &>(*this));
 	}
+	void bind(RegisterBank &bank) override final {
+		auto bind_one = [&bank](auto &member) { Visitor::bind(member, bank); };
+		visit_member(static_cast<_Tinput &>(*this), bind_one);
+		visit_member(static_cast<_Toutput &>(*this), bind_one);
+		visit_member(static_cast<_Tprivate &>(*this), bind_one);
+	}
+	void save(std::ostream &out) override final {
+		auto save_one = [&out](auto &member) { Visitor::save(member, out); };
+		visit_member(static_cast<_Tinput &>(*this), save_one);
+		visit_member(static_cast<_Toutput &>(*this), save_one);
+		visit_member(static_cast<_Tprivate &>(*this), save_one);
+		this->save_state(out);
+	}
+	void load(std::istream &in) override final {
+		auto load_one = [&in](auto &member) { Visitor::load(member, in); };
+		visit_member(static_cast<_Tinput &>(*this), load_one);
+		visit_member(static_cast<_Toutput &>(*this), load_one);
+		visit_member(static_cast<_Tprivate &>(*this), load_one);
+		this->load_state(in);
+	}
+	void hash(StateHash &h) override final {
+		auto hash_one = [&h](auto &member) {
+			using _Tp = std::decay_t<decltype(member)>;
+			if constexpr (Visitor::is_probable_v<_Tp> && !Visitor::is_wire_v<_Tp>)
+				h.add(static_cast<max_size_t>(member));
+		};
+		visit_member(static_cast<_Tinput &>(*this), hash_one);
+		visit_member(static_cast<_Toutput &>(*this), hash_one);
+		visit_member(static_cast<_Tprivate &>(*this), hash_one);
+		this->hash_state(h);
+	}
+	bool sample_inputs(std::vector<max_size_t> &snapshot) override final {
+		std::size_t count = 0;
+		bool changed = false;
+		visit_member(static_cast<_Tinput &>(*this), [&](auto &member) {
+			if constexpr (Visitor::is_wire_v<std::decay_t<decltype(member)>>) {
+				if (!Visitor::is_connected(member)) return;
+				const auto value = static_cast<max_size_t>(member);
+				if (count == snapshot.size()) {
+					snapshot.push_back(value);
+					changed = true;
+				} else if (snapshot[count] != value) {
+					snapshot[count] = value;
+					changed = true;
+				}
+				++count;
+			}
+		});
+		return changed;
+	}
+	void collect_wires(std::vector<details::WireNode> &nodes) override final {
+		auto collect_one = [&nodes](auto &member, const std::string &name) {
+			if constexpr (Visitor::is_wire_v<std::decay_t<decltype(member)>>)
+				if (Visitor::is_lambda_wire(member)) nodes.push_back(Visitor::wire_node(member, name));
+		};
+		visit_named(static_cast<_Tinput &>(*this), "", collect_one);
+		visit_named(static_cast<_Toutput &>(*this), "", collect_one);
+		visit_named(static_cast<_Tprivate &>(*this), "", collect_one);
+	}
+	void probe(std::vector<Probe> &probes) override final {
+		auto probe_one = [&probes](auto &member, const std::string &name) {
+			using _Tp = std::decay_t<decltype(member)>;
+			if constexpr (Visitor::is_probable_v<_Tp>) {
+				if constexpr (Visitor::is_wire_v<_Tp>)
+					if (!Visitor::is_connected(member)) return;
+				probes.push_back(Probe::make(name, member));
+			}
+		};
+		visit_named(static_cast<_Tinput &>(*this), "", probe_one);
+		visit_named(static_cast<_Toutput &>(*this), "", probe_one);
+		visit_named(static_cast<_Tprivate &>(*this), "", probe_one);
+	}
+};
+
+/**
+ * A module whose work() only ever assigns registers from its inputs and registers,
+ * so it is always idle, see ModuleBase::idle.
+ */
+template<typename _Tinput, typename _Toutput, typename _Tprivate = details::empty_class>
+struct PureModule : public Module<_Tinput, _Toutput, _Tprivate> {
+	bool idle() const override final { return true; }
 };
 
 } // namespace dark
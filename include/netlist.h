@@ -0,0 +1,86 @@
+#pragma once
+#include "register.h"
+#include "wire.h"
+#include <type_traits>
+
+namespace dark {
+
+namespace details {
+
+	template<typename _Tp>
+	struct member_pointer_traits {
+		static_assert(sizeof(_Tp) == 0, "Connect: expects pointers to members, e.g. &Module::member.");
+	};
+
+	template<typename _Member, typename _Class>
+	struct member_pointer_traits<_Member _Class::*> {
+		using class_type = _Class;
+		using member_type = _Member;
+	};
+
+	template<typename _Tp>
+	static constexpr bool is_register_v = false;
+	template<std::size_t _Len>
+	static constexpr bool is_register_v<Register<_Len>> = true;
+
+	template<typename _Tp>
+	static constexpr bool is_wire_v = false;
+	template<std::size_t _Len>
+	static constexpr bool is_wire_v<Wire<_Len>> = true;
+
+	/* The only module that holds a member of _Class. */
+	template<typename _Class, typename _First, typename... _Rest>
+	inline _Class &find_owner(_First &first, _Rest &...rest) {
+		if constexpr (std::is_base_of_v<_Class, _First>) {
+			static_assert(!(std::is_base_of_v<_Class, _Rest> || ...),
+						  "Netlist: the member belongs to more than one module.");
+			return static_cast<_Class &>(first);
+		} else {
+			static_assert(sizeof...(_Rest) != 0, "Netlist: no module holds the member.");
+			return find_owner<_Class>(rest...);
+		}
+	}
+
+} // namespace details
+
+/**
+ * One connection of a netlist: the wire _Dst reads the register _Src.
+ * Both are pointers to members, e.g. Connect<&ALU::result, &ReserveStation::completed_aluins_result>.
+ * Kinds and widths are checked at compile time.
+ */
+template<auto _Src, auto _Dst>
+struct Connect {
+private:
+	using _Src_traits = details::member_pointer_traits<decltype(_Src)>;
+	using _Dst_traits = details::member_pointer_traits<decltype(_Dst)>;
+	using _Src_t = typename _Src_traits::member_type;
+	using _Dst_t = typename _Dst_traits::member_type;
+
+	static_assert(details::is_register_v<_Src_t>, "Connect: the source must be a register.");
+	static_assert(details::is_wire_v<_Dst_t>, "Connect: the destination must be a wire.");
+	static_assert(_Src_t::_Bit_Len == _Dst_t::_Bit_Len,
+				  "Connect: the register and the wire must have the same width.");
+
+public:
+	template<typename... _Modules>
+	static void apply(_Modules &...modules) {
+		auto &src = details::find_owner<typename _Src_traits::class_type>(modules...);
+		auto &dst = details::find_owner<typename _Dst_traits::class_type>(modules...);
+		(dst.*_Dst).assign(src.*_Src);
+	}
+};
+
+/**
+ * A table of connections between the modules of a CPU.
+ * apply(modules...) connects every wire directly to its register,
+ * finding each end by the module that holds the member.
+ */
+template<typename... _Connects>
+struct Netlist {
+	template<typename... _Modules>
+	static void apply(_Modules &...modules) {
+		(_Connects::apply(modules...), ...);
+	}
+};
+
+} // namespace dark
@@ -0,0 +1,86 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace dark::details {
+
+/**
+ * A reusable barrier that spins for a while before yielding.
+ * Cycles are short, so sleeping on a futex would cost more than the work itself.
+ */
+class SpinBarrier {
+private:
+	const std::size_t _M_count;
+	std::atomic<std::size_t> _M_waiting;
+	std::atomic<std::size_t> _M_phase;
+
+public:
+	explicit SpinBarrier(std::size_t count) : _M_count(count), _M_waiting(0), _M_phase(0) {}
+
+	void arrive_and_wait() {
+		const auto phase = this->_M_phase.load(std::memory_order_relaxed);
+		if (this->_M_waiting.fetch_add(1, std::memory_order_acq_rel) + 1 == this->_M_count) {
+			this->_M_waiting.store(0, std::memory_order_relaxed);
+			this->_M_phase.store(phase + 1, std::memory_order_release);
+			return;
+		}
+		for (std::size_t spin = 0; this->_M_phase.load(std::memory_order_acquire) == phase; ++spin)
+			if (spin >= 1024) std::this_thread::yield();
+	}
+};
+
+/**
+ * A fixed set of threads that run the same job together, one index per thread.
+ * The calling thread takes index 0, so a pool of size n starts n - 1 threads.
+ */
+class WorkerPool {
+public:
+	using Job = std::function<void(std::size_t)>;
+
+private:
+	std::vector<std::thread> _M_threads;
+	SpinBarrier _M_start;
+	SpinBarrier _M_done;
+	const Job *_M_job = nullptr;
+	bool _M_stopping = false;
+
+	void _M_loop(std::size_t index) {
+		while (true) {
+			this->_M_start.arrive_and_wait();
+			if (this->_M_stopping) return;
+			(*this->_M_job)(index);
+			this->_M_done.arrive_and_wait();
+		}
+	}
+
+public:
+	explicit WorkerPool(std::size_t size) : _M_start(size), _M_done(size) {
+		for (std::size_t i = 1; i < size; ++i)
+			this->_M_threads.emplace_back(&WorkerPool::_M_loop, this, i);
+	}
+
+	WorkerPool(const WorkerPool &) = delete;
+	WorkerPool &operator=(const WorkerPool &) = delete;
+
+	~WorkerPool() {
+		this->_M_stopping = true;
+		this->_M_start.arrive_and_wait();
+		for (auto &thread: this->_M_threads)
+			thread.join();
+	}
+
+	std::size_t size() const { return this->_M_threads.size() + 1; }
+
+	/* Run job(i) for every index i in [0, size()) and wait for all of them. */
+	void run(const Job &job) {
+		this->_M_job = &job;
+		this->_M_start.arrive_and_wait();
+		job(0);
+		this->_M_done.arrive_and_wait();
+	}
+};
+
+} // namespace dark::details
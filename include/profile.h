@@ -0,0 +1,154 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <typeinfo>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#if defined(__GNUG__)
+#include <cstdlib>
+#include <cxxabi.h>
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace dark::profile {
+
+/* Time stamp counter, or nanoseconds where there is none. */
+inline std::uint64_t read_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+/* Readable name of the dynamic type of value. */
+template<typename _Tp>
+inline std::string type_name(const _Tp &value) {
+	const char *name = typeid(value).name();
+#if defined(__GNUG__)
+	int status = 0;
+	char *demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+	if (status == 0 && demangled != nullptr) {
+		std::string result = demangled;
+		std::free(demangled);
+		return result;
+	}
+#endif
+	return name;
+}
+
+/**
+ * Hardware counters of the calling thread, in user space only, read as one group.
+ * Needs Linux with perf_event_paranoid low enough; otherwise available() is false and reads give zeros.
+ */
+class PerfCounters {
+public:
+	static constexpr std::size_t kCount = 3;
+	static constexpr std::array<const char *, kCount> kNames = {"instructions", "cache-misses", "branch-misses"};
+	using Values = std::array<std::uint64_t, kCount>;
+
+private:
+	std::array<int, kCount> _M_fds;
+
+public:
+	PerfCounters() {
+		this->_M_fds.fill(-1);
+#ifdef __linux__
+		constexpr std::array<std::uint64_t, kCount> configs = {
+				PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+		for (std::size_t i = 0; i < kCount; ++i) {
+			perf_event_attr attr{};
+			attr.size = sizeof(attr);
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.config = configs[i];
+			attr.disabled = i == 0;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			attr.read_format = PERF_FORMAT_GROUP;
+			const int leader = this->_M_fds[0];
+			this->_M_fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+			if (this->_M_fds[i] < 0) {
+				this->_M_close();
+				return;
+			}
+		}
+		ioctl(this->_M_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+	}
+
+	PerfCounters(const PerfCounters &) = delete;
+	PerfCounters &operator=(const PerfCounters &) = delete;
+
+	~PerfCounters() { this->_M_close(); }
+
+	bool available() const { return this->_M_fds[0] >= 0; }
+
+	Values read() const {
+		Values values{};
+#ifdef __linux__
+		if (!this->available()) return values;
+		std::uint64_t buf[kCount + 1];
+		if (::read(this->_M_fds[0], buf, sizeof(buf)) == sizeof(buf))
+			for (std::size_t i = 0; i < kCount; ++i) values[i] = buf[i + 1];
+#endif
+		return values;
+	}
+
+private:
+	void _M_close() {
+#ifdef __linux__
+		for (auto &fd: this->_M_fds) {
+			if (fd >= 0) close(fd);
+			fd = -1;
+		}
+#endif
+	}
+};
+
+/* What one module cost the host, summed over all profiled cycles. */
+struct ModuleStats {
+	std::string name;
+	unsigned long long calls = 0;
+	std::uint64_t work_ticks = 0;
+	std::uint64_t sync_ticks = 0;
+	PerfCounters::Values work_events{};
+};
+
+inline void print(std::ostream &out, const std::vector<ModuleStats> &stats, bool events) {
+	std::uint64_t total = 0;
+	for (auto &module: stats) total += module.work_ticks + module.sync_ticks;
+	if (total == 0) total = 1;
+
+	const auto flags = out.flags();
+	out << std::left << std::setw(32) << "module" << std::right
+		<< std::setw(14) << "work/call" << std::setw(14) << "sync/call" << std::setw(9) << "share";
+	if (events)
+		for (auto *name: PerfCounters::kNames) out << std::setw(16) << name;
+	out << "   (ticks per call, events of work per call)\n";
+
+	out << std::fixed << std::setprecision(1);
+	for (auto &module: stats) {
+		const double calls = module.calls == 0 ? 1 : module.calls;
+		out << std::left << std::setw(32) << module.name << std::right
+			<< std::setw(14) << module.work_ticks / calls
+			<< std::setw(14) << module.sync_ticks / calls
+			<< std::setw(8) << 100.0 * (module.work_ticks + module.sync_ticks) / total << '%';
+		if (events)
+			for (auto count: module.work_events) out << std::setw(16) << count / calls;
+		out << '\n';
+	}
+	out.flags(flags);
+}
+
+} // namespace dark::profile
@@ -1,5 +1,6 @@
 #pragma once
 #include <concepts>
+#include <string_view>
 #include <tuple>
 
 namespace dark::reflect {
@@ -38,7 +39,7 @@ inline consteval auto member_size() -> std::size_t { return member_size_aux<_Tp>
 
 template<typename _Tp>
 	requires std::is_aggregate_v<_Tp>
-auto tuplify(_Tp &value) {
+constexpr auto tuplify(_Tp &value) {
 	constexpr auto size = member_size<_Tp>();
 	if constexpr (size == 1) {
 		auto &[x0] = value;
@@ -501,4 +502,38 @@ auto tuplify(_Tp &value) {
 	}
 }
 
+namespace details {
+
+	template<typename _Tp>
+	struct fake_wrapper { _Tp value; };
+
+	/* Never defined: only the addresses of its members are used, at compile time. */
+	template<typename _Tp>
+	extern const fake_wrapper<_Tp> fake_object;
+
+	template<auto _Ptr>
+	consteval std::string_view pointer_name() { return __PRETTY_FUNCTION__; }
+
+	/* The member from "... _Ptr = (& fake_object<T>.fake_wrapper<T>::value.T::name); ..." or "[_Ptr = &fake_object.value.name]". */
+	consteval std::string_view parse_member_name(std::string_view name) {
+		constexpr std::string_view marker = "_Ptr = ";
+		const auto begin = name.find(marker);
+		if (begin == std::string_view::npos) return {};
+		name = name.substr(begin + marker.size());
+		name = name.substr(0, name.find_first_of(";]"));
+		while (!name.empty() && name.back() == ')') name.remove_suffix(1);
+		const auto last = name.find_last_of(":.");
+		return last == std::string_view::npos ? std::string_view{} : name.substr(last + 1);
+	}
+
+} // namespace details
+
+/* The name of the _Idx-th member of an aggregate, or an empty string if the compiler does not tell. */
+template<typename _Tp, std::size_t _Idx>
+	requires std::is_aggregate_v<_Tp>
+inline consteval std::string_view member_name() {
+	auto &object = const_cast<_Tp &>(details::fake_object<_Tp>.value);
+	return details::parse_member_name(details::pointer_name<&std::get<_Idx>(tuplify(object))>());
+}
+
 } // namespace dark::reflect
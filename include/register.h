@@ -1,9 +1,53 @@
 #pragma once
+#include "checkpoint.h"
 #include "concept.h"
 #include "debug.h"
+#include "registerbank.h"
+#include <vector>
 
 namespace dark {
 
+namespace details {
+
+	/**
+	 * Registers assigned during the current cycle.
+	 * A register enqueues itself the first time it is assigned in a cycle,
+	 * so the CPU only needs to commit these instead of walking every module.
+	 */
+	struct DirtyList {
+		using _Commit_t = bool (*)(void *);
+
+		struct Entry {
+			void *reg;
+			_Commit_t commit;
+		};
+
+		std::vector<Entry> entries;
+
+		/* Also list registers bound to a bank, so that their changes can be seen at commit. */
+		bool list_bound = false;
+
+		void push(void *reg, _Commit_t commit) { this->entries.push_back({reg, commit}); }
+
+		void commit() {
+			this->commit(0, this->entries.size());
+			this->entries.clear();
+		}
+
+		/* Commit the entries in [begin, end) and return whether any register changed its value. */
+		bool commit(std::size_t begin, std::size_t end) {
+			bool changed = false;
+			for (auto i = begin; i < end; ++i)
+				changed |= this->entries[i].commit(this->entries[i].reg);
+			return changed;
+		}
+	};
+
+	/* The list of the CPU currently running on this thread, if any. */
+	inline thread_local DirtyList *active_dirty_list = nullptr;
+
+} // namespace details
+
 template<std::size_t _Len>
 struct Register {
 private:
@@ -14,39 +58,104 @@ private:
 
 	max_size_t _M_old : _Len;
 	max_size_t _M_new : _Len;
+	max_size_t _M_dirty : 1;
+
+	[[no_unique_address]]
+	details::BankSlot _M_slot;
 
 	[[no_unique_address]]
 	debug::DebugValue<bool, false> _M_assigned;
 
 	void sync() {
 		this->_M_assigned = false;
-		this->_M_old = this->_M_new;
+		this->_M_dirty = false;
+		if (this->_M_slot.bound())
+			this->_M_slot.sync();
+		else
+			this->_M_old = this->_M_new;
+	}
+
+	static bool _M_commit(void *ptr) {
+		auto &reg = *static_cast<Register *>(ptr);
+		const bool changed = reg._M_get_old() != reg._M_get_new();
+		reg.sync();
+		return changed;
+	}
+
+	void _M_bind(RegisterBank &bank) {
+		if (!this->_M_slot.bound())
+			bank.bind(this->_M_slot, this->_M_old, this->_M_new);
+	}
+
+	/* Save both planes, so that a restored register reads and peeks as before. */
+	void _M_save(std::ostream &out) const {
+		checkpoint::write_uint(out, this->_M_get_old(), checkpoint::kBytes<_Len>);
+		checkpoint::write_uint(out, this->_M_get_new(), checkpoint::kBytes<_Len>);
+	}
+
+	void _M_load(std::istream &in) {
+		const auto old_value = static_cast<max_size_t>(checkpoint::read_uint(in, checkpoint::kBytes<_Len>));
+		const auto new_value = static_cast<max_size_t>(checkpoint::read_uint(in, checkpoint::kBytes<_Len>));
+		this->_M_assigned = false;
+		this->_M_dirty = false;
+		if (this->_M_slot.bound()) {
+			this->_M_slot.set_old(old_value);
+			this->_M_slot.set_new(new_value);
+		} else {
+			this->_M_old = old_value;
+			this->_M_new = new_value;
+		}
+	}
+
+	max_size_t _M_get_old() const {
+		return this->_M_slot.bound() ? this->_M_slot.get_old() : this->_M_old;
+	}
+
+	max_size_t _M_get_new() const {
+		return this->_M_slot.bound() ? this->_M_slot.get_new() : this->_M_new;
 	}
 
 public:
 	static constexpr std::size_t _Bit_Len = _Len;
 
-	Register() : _M_old(), _M_new(), _M_assigned() {}
+	Register() : _M_old(), _M_new(), _M_dirty(), _M_assigned() {}
 
 	Register(Register &&) = delete;
 	Register(const Register &) = delete;
 	Register &operator=(Register &&) = delete;
 	Register &operator=(const Register &rhs) = delete;
 
+	/**
+	 * @attention Outside of CPU::run_once there is no dirty list,
+	 * so the value is only committed by an explicit sync of the module.
+	 */
 	template<concepts::bit_convertible<_Len> _Tp>
 	void operator<=(const _Tp &value) {
 		debug::assert(!this->_M_assigned, "Register is double assigned in this cycle.");
 		this->_M_assigned = true;
-		this->_M_new = static_cast<max_size_t>(value);
+		if (this->_M_slot.bound()) {
+			this->_M_slot.set_new(static_cast<max_size_t>(value) & make_mask<_Len>());
+#ifndef _DEBUG
+			// Committed with the whole bank. In debug mode, still listed to clear _M_assigned.
+			if (details::active_dirty_list == nullptr || !details::active_dirty_list->list_bound)
+				return;
+#endif
+		} else {
+			this->_M_new = static_cast<max_size_t>(value);
+		}
+		if (!this->_M_dirty && details::active_dirty_list != nullptr) {
+			this->_M_dirty = true;
+			details::active_dirty_list->push(this, &Register::_M_commit);
+		}
 	}
   auto peek() const -> max_size_t { // this function should only be used for convinience within the same module
     // if(this->_M_assigned) return this->_M_new;
     // return this->_M_old;
-    return this->_M_new;
+    return this->_M_get_new();
   }
 
-	explicit operator max_size_t() const { return this->_M_old; }
-	explicit operator bool() const { return this->_M_old; }
+	explicit operator max_size_t() const { return this->_M_get_old(); }
+	explicit operator bool() const { return this->_M_get_old(); }
 };
 
 } // namespace dark
@@ -0,0 +1,106 @@
+#pragma once
+#include "concept.h"
+#include <cstring>
+#include <vector>
+
+namespace dark {
+
+class RegisterBank;
+
+namespace details {
+
+#ifdef DARK_REGISTER_BANK
+	/* The location of a register's two planes inside a RegisterBank. */
+	struct BankSlot {
+	private:
+		friend class dark::RegisterBank;
+		max_size_t *_M_old = nullptr;
+		max_size_t *_M_new = nullptr;
+
+	public:
+		bool bound() const { return this->_M_old != nullptr; }
+		max_size_t get_old() const { return *this->_M_old; }
+		max_size_t get_new() const { return *this->_M_new; }
+		void set_old(max_size_t value) { *this->_M_old = value; }
+		void set_new(max_size_t value) { *this->_M_new = value; }
+		void sync() { *this->_M_old = *this->_M_new; }
+	};
+#else
+	/* Register banks are disabled: a slot is never bound and takes no space. */
+	struct BankSlot {
+		constexpr bool bound() const { return false; }
+		max_size_t get_old() const { return 0; }
+		max_size_t get_new() const { return 0; }
+		void set_old(max_size_t) { /* do nothing */ }
+		void set_new(max_size_t) { /* do nothing */ }
+		void sync() { /* do nothing */ }
+	};
+#endif
+
+} // namespace details
+
+/**
+ * Keeps the "old" and "new" planes of every bound register in two contiguous arrays,
+ * so that the end-of-cycle commit is a single plane copy.
+ * Registers are only bound when compiled with DARK_REGISTER_BANK.
+ */
+class RegisterBank {
+private:
+	std::vector<max_size_t> _M_old;
+	std::vector<max_size_t> _M_new;
+	std::vector<details::BankSlot *> _M_slots;
+
+#ifdef DARK_REGISTER_BANK
+	void _M_point(std::size_t index) {
+		this->_M_slots[index]->_M_old = &this->_M_old[index];
+		this->_M_slots[index]->_M_new = &this->_M_new[index];
+	}
+#endif
+
+public:
+	static constexpr bool enabled =
+#ifdef DARK_REGISTER_BANK
+			true;
+#else
+			false;
+#endif
+
+	RegisterBank() = default;
+	RegisterBank(const RegisterBank &) = delete;
+	RegisterBank &operator=(const RegisterBank &) = delete;
+
+	/* Move the register state into the bank. The register must stay alive as long as the bank. */
+	void bind(details::BankSlot &slot, max_size_t old_value, max_size_t new_value) {
+#ifdef DARK_REGISTER_BANK
+		const auto *old_data = this->_M_old.data();
+		const auto *new_data = this->_M_new.data();
+		this->_M_old.push_back(old_value);
+		this->_M_new.push_back(new_value);
+		this->_M_slots.push_back(&slot);
+		if (old_data == this->_M_old.data() && new_data == this->_M_new.data()) {
+			this->_M_point(this->_M_slots.size() - 1);
+		} else { // Reallocated, so every slot must be pointed again.
+			for (std::size_t i = 0; i < this->_M_slots.size(); ++i)
+				this->_M_point(i);
+		}
+#else
+		(void)slot, (void)old_value, (void)new_value;
+#endif
+	}
+
+	std::size_t size() const { return this->_M_slots.size(); }
+
+	void commit() { this->commit(0, 1); }
+
+	/* Commit the part-th of parts equal slices, so that several threads can share the copy. */
+	void commit(std::size_t part, std::size_t parts) {
+		const auto size  = this->_M_new.size();
+		const auto begin = size * part / parts;
+		const auto end   = size * (part + 1) / parts;
+		if (begin != end)
+			std::memcpy(this->_M_old.data() + begin, this->_M_new.data() + begin,
+						(end - begin) * sizeof(max_size_t));
+	}
+};
+
+} // namespace dark
@@ -40,14 +40,16 @@ struct RegisterFile_Private {
   std::array<dark::Register<5>, kTotalRegisters> register_deps;
   std::array<dark::Register<1>, kTotalRegisters> register_nodep;
 };
-struct RegisterFile : public dark::Module<RegisterFile_Input, RegisterFile_Output, RegisterFile_Private> {
+struct RegisterFile : public dark::PureModule<RegisterFile_Input, RegisterFile_Output, RegisterFile_Private> {
   RegisterFile() {
     // Constructor
   }
   uint8_t ReturnExitCodeImmediately() {
+    // read the committed value: the CSU works before the register file in this cycle, so this is what peek() would
+    // see anyway, and it stays well defined when the modules work in parallel
     DEBUG_CERR << "Register File: CSU is collecting exit code" << std::endl;
-    DEBUG_CERR << "Sent " << std::dec << (registers[10].peek() & 0xff) << std::endl;
-    return registers[10].peek() & 0xff;
+    DEBUG_CERR << "Sent " << std::dec << (static_cast<max_size_t>(registers[10]) & 0xff) << std::endl;
+    return static_cast<max_size_t>(registers[10]) & 0xff;
   }
   void work() {
     if (bool(reset)) {
@@ -0,0 +1,161 @@
+#pragma once
+#include "register.h"
+#include <array>
+
+namespace dark {
+
+/**
+ * Several narrow registers sharing one word per plane, e.g. the flags of a queue entry.
+ * field<_Idx>() is the _Idx-th register: it is assigned with <= and read like a Register of its width.
+ * The whole pack is listed and committed at once, so a record of many flags takes less space
+ * than one Register per flag, and a scan over the records touches fewer cache lines.
+ */
+template<std::size_t... _Lens>
+struct RegisterPack {
+private:
+	static_assert(sizeof...(_Lens) != 0 && ((0 < _Lens) && ...),
+				  "RegisterPack: every field needs at least one bit.");
+	static_assert((_Lens + ...) <= kMaxLength,
+				  "RegisterPack: the fields must fit in one max_size_t.");
+
+	friend class Visitor;
+
+	static constexpr std::array<std::size_t, sizeof...(_Lens)> _S_lens = {_Lens...};
+
+	static constexpr std::size_t _S_offset(std::size_t idx) {
+		std::size_t offset = 0;
+		for (std::size_t i = 0; i < idx; ++i) offset += _S_lens[i];
+		return offset;
+	}
+
+	template<std::size_t _Idx>
+	static constexpr max_size_t _S_mask() { return make_mask<_S_lens[_Idx]>() << _S_offset(_Idx); }
+
+	max_size_t _M_old;
+	max_size_t _M_new;
+	bool _M_dirty;
+
+	[[no_unique_address]]
+	details::BankSlot _M_slot;
+
+	/* The fields assigned in this cycle. */
+	[[no_unique_address]]
+	debug::DebugValue<max_size_t, 0> _M_assigned;
+
+	void sync() {
+		this->_M_assigned = 0;
+		this->_M_dirty = false;
+		if (this->_M_slot.bound())
+			this->_M_slot.sync();
+		else
+			this->_M_old = this->_M_new;
+	}
+
+	static bool _M_commit(void *ptr) {
+		auto &pack = *static_cast<RegisterPack *>(ptr);
+		const bool changed = pack._M_get_old() != pack._M_get_new();
+		pack.sync();
+		return changed;
+	}
+
+	void _M_bind(RegisterBank &bank) {
+		if (!this->_M_slot.bound())
+			bank.bind(this->_M_slot, this->_M_old, this->_M_new);
+	}
+
+	void _M_save(std::ostream &out) const {
+		checkpoint::write_uint(out, this->_M_get_old(), checkpoint::kBytes<_Bit_Len>);
+		checkpoint::write_uint(out, this->_M_get_new(), checkpoint::kBytes<_Bit_Len>);
+	}
+
+	void _M_load(std::istream &in) {
+		const auto old_value = static_cast<max_size_t>(checkpoint::read_uint(in, checkpoint::kBytes<_Bit_Len>));
+		const auto new_value = static_cast<max_size_t>(checkpoint::read_uint(in, checkpoint::kBytes<_Bit_Len>));
+		this->_M_assigned = 0;
+		this->_M_dirty = false;
+		if (this->_M_slot.bound()) {
+			this->_M_slot.set_old(old_value);
+			this->_M_slot.set_new(new_value);
+		} else {
+			this->_M_old = old_value;
+			this->_M_new = new_value;
+		}
+	}
+
+	max_size_t _M_get_old() const {
+		return this->_M_slot.bound() ? this->_M_slot.get_old() : this->_M_old;
+	}
+
+	max_size_t _M_get_new() const {
+		return this->_M_slot.bound() ? this->_M_slot.get_new() : this->_M_new;
+	}
+
+	/* Same as Register::operator<=, on the bits of one field. */
+	template<std::size_t _Idx>
+	void _M_assign(max_size_t value) {
+		constexpr auto mask = _S_mask<_Idx>();
+		debug::assert(!(static_cast<max_size_t>(this->_M_assigned) & mask), "Register is double assigned in this cycle.");
+		this->_M_assigned = static_cast<max_size_t>(this->_M_assigned) | mask;
+		const auto word = (this->_M_get_new() & ~mask) | ((value << _S_offset(_Idx)) & mask);
+		if (this->_M_slot.bound()) {
+			this->_M_slot.set_new(word);
+#ifndef _DEBUG
+			if (details::active_dirty_list == nullptr || !details::active_dirty_list->list_bound)
+				return;
+#endif
+		} else {
+			this->_M_new = word;
+		}
+		if (!this->_M_dirty && details::active_dirty_list != nullptr) {
+			this->_M_dirty = true;
+			details::active_dirty_list->push(this, &RegisterPack::_M_commit);
+		}
+	}
+
+public:
+	static constexpr std::size_t _Bit_Len = (_Lens + ...);
+
+	/* One register of the pack. A short-lived view, get it again with field<_Idx>() when needed. */
+	template<std::size_t _Idx>
+	struct Field {
+	private:
+		RegisterPack &_M_pack;
+
+		static constexpr std::size_t _S_shift = _S_offset(_Idx);
+
+	public:
+		static constexpr std::size_t _Bit_Len = _S_lens[_Idx];
+
+		explicit Field(RegisterPack &pack) : _M_pack(pack) {}
+
+		template<concepts::bit_convertible<_Bit_Len> _Tp>
+		void operator<=(const _Tp &value) {
+			this->_M_pack.template _M_assign<_Idx>(static_cast<max_size_t>(value));
+		}
+
+		auto peek() const -> max_size_t {
+			return (this->_M_pack._M_get_new() & _S_mask<_Idx>()) >> _S_shift;
+		}
+
+		explicit operator max_size_t() const {
+			return (this->_M_pack._M_get_old() & _S_mask<_Idx>()) >> _S_shift;
+		}
+		explicit operator bool() const { return static_cast<max_size_t>(*this) != 0; }
+	};
+
+	RegisterPack() : _M_old(), _M_new(), _M_dirty(), _M_assigned() {}
+
+	RegisterPack(RegisterPack &&) = delete;
+	RegisterPack(const RegisterPack &) = delete;
+	RegisterPack &operator=(RegisterPack &&) = delete;
+	RegisterPack &operator=(const RegisterPack &rhs) = delete;
+
+	template<std::size_t _Idx>
+		requires (_Idx < sizeof...(_Lens))
+	Field<_Idx> field() { return Field<_Idx>(*this); }
+
+	/* The whole word, fields in order from the least significant bit. */
+	explicit operator max_size_t() const { return this->_M_get_old(); }
+};
+
+} // namespace dark
@@ -0,0 +1,192 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace dark {
+
+/**
+ * A 64-bit hash of a sequence of values, e.g. of every register of a CPU, see CPU::state_hash.
+ * The order of the values matters. Not cryptographic, but every bit of a value reaches every bit of the hash.
+ */
+class StateHash {
+private:
+	std::uint64_t _M_value = 0x243f6a8885a308d3;
+
+public:
+	/* The finalizer of splitmix64. */
+	static constexpr std::uint64_t mix(std::uint64_t x) {
+		x ^= x >> 30;
+		x *= 0xbf58476d1ce4e5b9;
+		x ^= x >> 27;
+		x *= 0x94d049bb133111eb;
+		x ^= x >> 31;
+		return x;
+	}
+
+	void add(std::uint64_t value) { this->_M_value = mix(this->_M_value + value + 0x9e3779b97f4a7c15); }
+
+	/* Hash raw bytes, 8 at a time. */
+	void add_bytes(const void *data, std::size_t size) {
+		const auto *bytes = static_cast<const unsigned char *>(data);
+		std::uint64_t word;
+		for (; size >= sizeof(word); bytes += sizeof(word), size -= sizeof(word)) {
+			std::memcpy(&word, bytes, sizeof(word));
+			this->add(word);
+		}
+		word = 0;
+		std::memcpy(&word, bytes, size);
+		this->add(word ^ size);
+	}
+
+	std::uint64_t value() const { return this->_M_value; }
+};
+
+namespace hash {
+
+static constexpr char kMagic[8] = {'D', 'A', 'R', 'K', 'H', 'S', 'H', '1'};
+
+struct Sample {
+	unsigned long long cycle;
+	std::uint64_t hash;
+};
+
+/**
+ * Records the state hash of a CPU every interval cycles into a file, see CPU::set_state_hash.
+ * The file is the magic, then one (8-byte cycle, 8-byte hash) record per sample, little endian.
+ */
+class Recorder {
+private:
+	static constexpr std::size_t kFlushSize = 1 << 12;
+
+	std::FILE *_M_file;
+	const unsigned long long _M_interval;
+	unsigned long long _M_begin = 0;
+	unsigned long long _M_end = 0;
+	std::vector<Sample> _M_buffer;
+
+public:
+	Recorder(const std::string &path, unsigned long long interval)
+		: _M_file(std::fopen(path.c_str(), "wb")), _M_interval(interval) {
+		if (this->_M_file == nullptr)
+			throw std::runtime_error("Recorder: cannot open " + path);
+		if (interval == 0) {
+			std::fclose(this->_M_file);
+			throw std::invalid_argument("Recorder: the interval must be at least one cycle.");
+		}
+		std::fwrite(kMagic, 1, sizeof(kMagic), this->_M_file);
+		this->_M_buffer.reserve(kFlushSize);
+	}
+
+	Recorder(const Recorder &) = delete;
+	Recorder &operator=(const Recorder &) = delete;
+
+	~Recorder() {
+		this->flush();
+		std::fclose(this->_M_file);
+	}
+
+	/* Record only the cycles in [begin, end). An end of 0 means no end. */
+	void set_window(unsigned long long begin, unsigned long long end = 0) {
+		this->_M_begin = begin;
+		this->_M_end = end;
+	}
+
+	/* Whether the state at the end of the given cycle is to be recorded. */
+	bool due(unsigned long long cycle) const {
+		return cycle % this->_M_interval == 0 && cycle >= this->_M_begin
+			&& (this->_M_end == 0 || cycle < this->_M_end);
+	}
+
+	void record(unsigned long long cycle, std::uint64_t hash) {
+		this->_M_buffer.push_back({cycle, hash});
+		if (this->_M_buffer.size() >= kFlushSize) this->flush();
+	}
+
+	void flush() {
+		unsigned char bytes[16];
+		for (auto &sample: this->_M_buffer) {
+			for (int i = 0; i < 8; ++i) {
+				bytes[i] = static_cast<unsigned char>(sample.cycle >> (i * 8));
+				bytes[i + 8] = static_cast<unsigned char>(sample.hash >> (i * 8));
+			}
+			std::fwrite(bytes, 1, sizeof(bytes), this->_M_file);
+		}
+		this->_M_buffer.clear();
+	}
+};
+
+/* Read all samples written by a Recorder. */
+inline std::vector<Sample> read(const std::string &path) {
+	std::FILE *file = std::fopen(path.c_str(), "rb");
+	if (file == nullptr)
+		throw std::runtime_error("hash::read: cannot open " + path);
+	char magic[sizeof(kMagic)];
+	if (std::fread(magic, 1, sizeof(magic), file) != sizeof(magic) || std::memcmp(magic, kMagic, sizeof(magic)) != 0) {
+		std::fclose(file);
+		throw std::runtime_error("hash::read: not a state hash file: " + path);
+	}
+	std::vector<Sample> samples;
+	unsigned char bytes[16];
+	std::size_t count;
+	while ((count = std::fread(bytes, 1, sizeof(bytes), file)) == sizeof(bytes)) {
+		Sample sample = {0, 0};
+		for (int i = 7; i >= 0; --i) {
+			sample.cycle = sample.cycle << 8 | bytes[i];
+			sample.hash = sample.hash << 8 | bytes[i + 8];
+		}
+		samples.push_back(sample);
+	}
+	std::fclose(file);
+	if (count != 0)
+		throw std::runtime_error("hash::read: the file is truncated: " + path);
+	return samples;
+}
+
+struct Divergence {
+	bool found;
+	unsigned long long last_equal;		// cycle of the last equal sample before it, 0 if none
+	unsigned long long first_different;	// cycle of the first sample that differs
+};
+
+/**
+ * Find the first divergent sample of two streams, by bisection over the samples of the same cycles.
+ * Two runs that diverge rarely converge again, so the equal samples form a prefix;
+ * if they do converge, some divergent sample is still found, just maybe not the first one.
+ * A stream that ends early, e.g. because its run halted, diverges at its end.
+ */
+inline Divergence bisect(std::vector<Sample> lhs, std::vector<Sample> rhs) {
+	// A stream that starts later, e.g. from a checkpoint, is compared from its first cycle on.
+	auto starts_before = [](const std::vector<Sample> &a, const std::vector<Sample> &b) {
+		return !a.empty() && !b.empty() && a.front().cycle < b.front().cycle;
+	};
+	auto drop_before = [](std::vector<Sample> &samples, unsigned long long cycle) {
+		std::erase_if(samples, [cycle](const Sample &sample) { return sample.cycle < cycle; });
+	};
+	if (starts_before(lhs, rhs)) drop_before(lhs, rhs.front().cycle);
+	if (starts_before(rhs, lhs)) drop_before(rhs, lhs.front().cycle);
+
+	const auto common = std::min(lhs.size(), rhs.size());
+	auto equal = [&](std::size_t i) { return lhs[i].cycle == rhs[i].cycle && lhs[i].hash == rhs[i].hash; };
+	std::size_t low = 0, high = common;	// [0, low) are equal, [high, common) are not
+	while (low < high) {
+		const auto mid = low + (high - low) / 2;
+		if (equal(mid)) low = mid + 1;
+		else high = mid;
+	}
+	const unsigned long long last_equal = low == 0 ? 0 : lhs[low - 1].cycle;
+	if (low < common)
+		return {true, last_equal, std::min(lhs[low].cycle, rhs[low].cycle)};
+	if (lhs.size() != rhs.size())
+		return {true, last_equal, low < lhs.size() ? lhs[low].cycle : rhs[low].cycle};
+	return {false, last_equal, 0};
+}
+
+} // namespace hash
+
+} // namespace dark
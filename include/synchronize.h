@@ -1,6 +1,11 @@
 #pragma once
 #include "reflect.h"
+#include "registerbank.h"
 #include <array>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <utility>
 
 namespace dark {
 
@@ -15,6 +20,69 @@ struct Visitor {
 
 	template<typename _Tp, typename _Base>
 	static _Base &cast(_Tp &value) { return static_cast<_Base &>(value); }
+
+	template<typename _Tp>
+	static constexpr bool is_bindable_v =
+			requires(_Tp &val, RegisterBank &bank) { val._M_bind(bank); };
+
+	/* Bind a register to the bank. Other syncable members are left as is. */
+	template<typename _Tp>
+	static void bind(_Tp &val, RegisterBank &bank) {
+		if constexpr (is_bindable_v<_Tp>) val._M_bind(bank);
+	}
+
+	template<typename _Tp>
+	static constexpr bool is_savable_v =
+			requires(_Tp &val, std::ostream &out, std::istream &in) { val._M_save(out); val._M_load(in); };
+
+	/* Save a register to a checkpoint. Wires hold no state and are skipped. */
+	template<typename _Tp>
+	static void save(_Tp &val, std::ostream &out) {
+		if constexpr (is_savable_v<_Tp>) val._M_save(out);
+	}
+
+	template<typename _Tp>
+	static void load(_Tp &val, std::istream &in) {
+		if constexpr (is_savable_v<_Tp>) val._M_load(in);
+	}
+
+	template<typename _Tp>
+	static constexpr bool is_wire_v =
+			requires(const _Tp &val) { { val._M_connected() } -> std::same_as<bool>; };
+
+	template<typename _Tp>
+		requires is_wire_v<_Tp>
+	static bool is_connected(const _Tp &val) { return val._M_connected(); }
+
+	/* Whether the wire computes its value with a lambda, rather than reading a register directly. */
+	template<typename _Tp>
+		requires is_wire_v<_Tp>
+	static bool is_lambda_wire(const _Tp &val) { return val._M_func != nullptr; }
+
+	template<typename _Tp>
+		requires is_wire_v<_Tp>
+	static auto wire_node(_Tp &val, std::string name) { return val._M_node(std::move(name)); }
+
+	template<typename _Tp>
+	static constexpr bool is_probable_v =
+			requires(const _Tp &val) { _Tp::_Bit_Len; static_cast<max_size_t>(val); };
+};
+
+/* A register or wire that can be read by address, e.g. to record a waveform. */
+struct Probe {
+	std::string name;
+	std::size_t width;
+	const void *value;
+	max_size_t (*read)(const void *);
+
+	template<typename _Tp>
+		requires Visitor::is_probable_v<_Tp>
+	static Probe make(std::string name, const _Tp &value) {
+		return {std::move(name), _Tp::_Bit_Len, &value,
+				[](const void *ptr) { return static_cast<max_size_t>(*static_cast<const _Tp *>(ptr)); }};
+	}
+
+	max_size_t get() const { return this->read(this->value); }
 };
 
 template<typename... _Base>
@@ -32,35 +100,86 @@ static constexpr bool is_std_array_v = std::is_array_v<_Tp>;
 template<typename _Tp, std::size_t _Nm>
 static constexpr bool is_std_array_v<std::array<_Tp, _Nm>> = true;
 
-template<typename _Tp>
-inline void sync_member(_Tp &value);
+template<typename _Tp, typename _Fn>
+inline void visit_member(_Tp &value, _Fn &&fn);
 
-template<typename _Tp, typename... _Base>
-inline void sync_by_tag(_Tp &value, SyncTags<_Base...>) {
-	(sync_member(Visitor::cast<_Tp, _Base>(value)), ...);
+template<typename _Tp, typename _Fn, typename... _Base>
+inline void visit_by_tag(_Tp &value, _Fn &fn, SyncTags<_Base...>) {
+	(visit_member(Visitor::cast<_Tp, _Base>(value), fn), ...);
 }
 
-template<typename _Tp>
-inline void sync_member(_Tp &value) {
+/**
+ * Call fn on every syncable member (register, wire, ...) of value,
+ * in declaration order. The same rules as sync_member apply.
+ */
+template<typename _Tp, typename _Fn>
+inline void visit_member(_Tp &value, _Fn &&fn) {
 	if constexpr (std::is_const_v<_Tp>) {
 		/* Do nothing! Constant members need no synchronization! */
 	}
 	else if constexpr (is_std_array_v<_Tp>) {
-		for (auto &member: value) sync_member(member);
+		for (auto &member: value) visit_member(member, fn);
 	}
 	else if constexpr (Visitor::is_syncable_v<_Tp>) {
-		Visitor::sync(value);
+		fn(value);
 	}
 	else if constexpr (has_valid_tag<_Tp>) {
-		sync_by_tag(value, typename _Tp::Tags{});
+		visit_by_tag(value, fn, typename _Tp::Tags{});
 	}
 	else if constexpr (std::is_aggregate_v<_Tp>) {
 		auto &&tuple = reflect::tuplify(value);
-		std::apply([](auto &...members) { (sync_member(members), ...); }, tuple);
+		std::apply([&fn](auto &...members) { (visit_member(members, fn), ...); }, tuple);
 	}
 	else {
 		static_assert(sizeof(_Tp) == 0, "This type is not syncable.");
 	}
 }
 
+template<typename _Tp, typename _Fn>
+inline void visit_named(_Tp &value, const std::string &name, _Fn &&fn);
+
+template<typename _Tp, typename _Fn, std::size_t... _Idx>
+inline void visit_named_members(_Tp &value, const std::string &name, _Fn &fn, std::index_sequence<_Idx...>) {
+	auto &&tuple = reflect::tuplify(value);
+	auto join = [&name](std::string_view member, std::size_t index) {
+		auto result = name.empty() ? name : name + '.';
+		return member.empty() ? result + std::to_string(index) : result.append(member);
+	};
+	(visit_named(std::get<_Idx>(tuple), join(reflect::member_name<_Tp, _Idx>(), _Idx), fn), ...);
+}
+
+/**
+ * Like visit_member, but also pass the path of every member,
+ * e.g. "ROB_records[3].instruction", as fn(member, name).
+ */
+template<typename _Tp, typename _Fn>
+inline void visit_named(_Tp &value, const std::string &name, _Fn &&fn) {
+	if constexpr (std::is_const_v<_Tp>) {
+		/* Constant members are not signals. */
+	}
+	else if constexpr (is_std_array_v<_Tp>) {
+		std::size_t index = 0;
+		for (auto &member: value) visit_named(member, name + '[' + std::to_string(index++) + ']', fn);
+	}
+	else if constexpr (Visitor::is_syncable_v<_Tp>) {
+		fn(value, name);
+	}
+	else if constexpr (has_valid_tag<_Tp>) {
+		[&]<typename... _Base>(SyncTags<_Base...>) {
+			(visit_named(Visitor::cast<_Tp, _Base>(value), name, fn), ...);
+		}(typename _Tp::Tags{});
+	}
+	else if constexpr (std::is_aggregate_v<_Tp>) {
+		visit_named_members(value, name, fn, std::make_index_sequence<reflect::member_size<_Tp>()>{});
+	}
+	else {
+		static_assert(sizeof(_Tp) == 0, "This type is not syncable.");
+	}
+}
+
+template<typename _Tp>
+inline void sync_member(_Tp &value) {
+	visit_member(value, [](auto &member) { Visitor::sync(member); });
+}
+
 } // namespace dark
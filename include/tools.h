@@ -3,6 +3,7 @@
 #include "bit_impl.h"
 #include "operator.h"
 #include "register.h"
+#include "registerpack.h"
 #include "synchronize.h"
 #include "wire.h"
 #include "module.h"
@@ -10,12 +11,12 @@
 #include<iostream>
 #include<iomanip>
 
-extern unsigned int global_clock;
 using dark::Bit;
 using dark::sign_extend;
 using dark::zero_extend;
 
 using dark::Register;
+using dark::RegisterPack;
 using dark::Wire;
 
 using dark::sync_member;
@@ -0,0 +1,167 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Binary event tracing.
+ * Events are fixed-size records pushed into a ring buffer of the current thread,
+ * and a background thread of the Tracer drains every ring into a file.
+ * Decode the file offline, e.g. with the tracedump tool.
+ */
+namespace dark::trace {
+
+static constexpr char kMagic[8] = {'D', 'A', 'R', 'K', 'T', 'R', 'C', '1'};
+
+struct Record {
+	std::uint32_t cycle;
+	std::uint16_t event;
+	std::uint16_t reserved;
+	std::uint32_t args[3];
+};
+
+/* A ring written by one thread and drained by the Tracer. */
+class Ring {
+private:
+	std::unique_ptr<Record[]> _M_data;
+	const std::size_t _M_mask;
+	std::atomic<std::size_t> _M_head;	// next record to write
+	std::atomic<std::size_t> _M_tail;	// next record to drain
+
+public:
+	/* capacity must be a power of 2. */
+	explicit Ring(std::size_t capacity)
+		: _M_data(new Record[capacity]), _M_mask(capacity - 1), _M_head(0), _M_tail(0) {}
+
+	/* Waits for the drainer when the ring is full, so no record is ever lost. */
+	void push(const Record &record) {
+		const auto head = this->_M_head.load(std::memory_order_relaxed);
+		while (head - this->_M_tail.load(std::memory_order_acquire) > this->_M_mask)
+			std::this_thread::yield();
+		this->_M_data[head & this->_M_mask] = record;
+		this->_M_head.store(head + 1, std::memory_order_release);
+	}
+
+	/* Write the pending records to file, return how many. */
+	std::size_t drain(std::FILE *file) {
+		const auto tail = this->_M_tail.load(std::memory_order_relaxed);
+		const auto head = this->_M_head.load(std::memory_order_acquire);
+		for (auto pos = tail; pos != head;) {
+			const auto begin = pos & this->_M_mask;
+			const auto count = std::min(head - pos, this->_M_mask + 1 - begin);
+			std::fwrite(&this->_M_data[begin], sizeof(Record), count, file);
+			pos += count;
+		}
+		this->_M_tail.store(head, std::memory_order_release);
+		return head - tail;
+	}
+};
+
+/* The ring of the current thread, set by Tracer::attach. */
+inline thread_local Ring *active_ring = nullptr;
+
+/* Record an event if the current thread is attached to a Tracer. */
+inline void emit(std::uint16_t event, std::uint32_t cycle,
+				 std::uint32_t a = 0, std::uint32_t b = 0, std::uint32_t c = 0) {
+	if (auto *ring = active_ring) [[unlikely]]
+		ring->push({cycle, event, 0, {a, b, c}});
+}
+
+/**
+ * Owns the trace file and the thread draining the rings into it.
+ * @attention every thread must detach before the Tracer is destroyed;
+ * the destructor detaches the thread running it.
+ */
+class Tracer {
+private:
+	std::FILE *_M_file;
+	const std::size_t _M_capacity;
+	std::mutex _M_mutex;
+	std::vector<std::unique_ptr<Ring>> _M_rings;
+	std::atomic<bool> _M_stopping;
+	std::thread _M_drainer;
+
+	void _M_drain_all() {
+		std::lock_guard lock(this->_M_mutex);
+		for (auto &ring: this->_M_rings) ring->drain(this->_M_file);
+	}
+
+public:
+	explicit Tracer(const std::string &path, std::size_t capacity = 1 << 16)
+		: _M_file(std::fopen(path.c_str(), "wb")), _M_capacity(capacity), _M_stopping(false) {
+		if (this->_M_file == nullptr)
+			throw std::runtime_error("Tracer: cannot open " + path);
+		if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+			throw std::invalid_argument("Tracer: the capacity must be a power of 2.");
+		std::setvbuf(this->_M_file, nullptr, _IOFBF, 1 << 20);
+		std::fwrite(kMagic, 1, sizeof(kMagic), this->_M_file);
+		this->_M_drainer = std::thread([this] {
+			while (!this->_M_stopping.load(std::memory_order_acquire)) {
+				this->_M_drain_all();
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		});
+	}
+
+	Tracer(const Tracer &) = delete;
+	Tracer &operator=(const Tracer &) = delete;
+
+	~Tracer() {
+		this->detach();
+		this->_M_stopping.store(true, std::memory_order_release);
+		this->_M_drainer.join();
+		this->_M_drain_all();
+		std::fclose(this->_M_file);
+	}
+
+	/* Record the events emitted by the current thread. */
+	void attach() {
+		std::lock_guard lock(this->_M_mutex);
+		this->_M_rings.push_back(std::make_unique<Ring>(this->_M_capacity));
+		active_ring = this->_M_rings.back().get();
+	}
+
+	void detach() {
+		std::lock_guard lock(this->_M_mutex);
+		for (auto &ring: this->_M_rings)
+			if (ring.get() == active_ring) active_ring = nullptr;
+	}
+};
+
+/* Read a trace file written by a Tracer, one record at a time. */
+class Reader {
+private:
+	std::FILE *_M_file;
+
+public:
+	explicit Reader(const std::string &path) : _M_file(std::fopen(path.c_str(), "rb")) {
+		if (this->_M_file == nullptr)
+			throw std::runtime_error("Reader: cannot open " + path);
+		char magic[sizeof(kMagic)];
+		if (std::fread(magic, 1, sizeof(magic), this->_M_file) != sizeof(magic)
+				|| std::memcmp(magic, kMagic, sizeof(magic)) != 0) {
+			std::fclose(this->_M_file);
+			throw std::runtime_error("Reader: not a trace file: " + path);
+		}
+	}
+
+	Reader(const Reader &) = delete;
+	Reader &operator=(const Reader &) = delete;
+
+	~Reader() { std::fclose(this->_M_file); }
+
+	bool next(Record &record) {
+		return std::fread(&record, sizeof(Record), 1, this->_M_file) == 1;
+	}
+};
+
+} // namespace dark::trace
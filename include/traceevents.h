@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include "concept.h"
+#ifndef TRACEEVENTS_H
+#include "trace.h"
+namespace ZYM {
+// events of the processor recorded through dark::trace::emit
+enum TraceEvent : uint16_t {
+  kTraceIssue = 1,  // args: PC, instruction, ROB index
+  kTraceCommit,     // args: instruction, destination register (0 if none), value
+  kTraceFlush,      // args: instruction, correct PC, ROB index
+  kTraceMemRead,    // args: address, data, bytes
+  kTraceMemWrite,   // args: address, data, bytes
+};
+struct TraceEventInfo {
+  const char *name;
+  const char *args[3];
+  bool hex[3];
+};
+// used by the decoder to print the records, nullptr for unknown events
+inline const TraceEventInfo *GetTraceEventInfo(uint16_t event) {
+  static constexpr TraceEventInfo kInfos[] = {
+      {"issue", {"PC", "instruction", "ROB_index"}, {true, true, false}},
+      {"commit", {"instruction", "rd", "value"}, {true, false, true}},
+      {"flush", {"instruction", "PC", "ROB_index"}, {true, true, false}},
+      {"mem_read", {"address", "data", "bytes"}, {true, true, false}},
+      {"mem_write", {"address", "data", "bytes"}, {true, true, false}},
+  };
+  if (event < kTraceIssue || event > kTraceMemWrite) return nullptr;
+  return &kInfos[event - kTraceIssue];
+}
+}  // namespace ZYM
+#endif
@@ -0,0 +1,327 @@
+#pragma once
+#include "module.h"
+#include "profile.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Waveforms of every register and wire, as value changes per cycle.
+ * The output is either standard VCD, or a compact binary format read by Reader:
+ *   magic, varint signal count, and per signal: scope, name (varint length + bytes), varint width;
+ *   then blocks of: varint cycle delta, (varint index delta, varint value)... , varint 0.
+ * Index deltas are relative to the previous change of the block plus one, so they are never 0.
+ */
+namespace dark::wave {
+
+static constexpr char kMagic[8] = {'D', 'A', 'R', 'K', 'W', 'A', 'V', '1'};
+
+enum class Format { VCD, Binary };
+
+struct Signal {
+	std::string scope;
+	std::string name;
+	std::size_t width;
+};
+
+/* Writes declared signals and their changes to file through a local buffer. */
+class Writer {
+private:
+	static constexpr std::size_t kFlushSize = 1 << 16;
+
+	std::FILE *_M_file;
+	const Format _M_format;
+	std::string _M_buffer;
+	std::vector<Signal> _M_signals;
+	unsigned long long _M_cycle = 0;	// of the last time stamp
+	std::size_t _M_next = 0;			// binary: index of the last change in the block plus one
+	bool _M_started = false;
+
+	void _M_varint(std::uint64_t value) {
+		for (; value >= 0x80; value >>= 7)
+			this->_M_buffer.push_back(static_cast<char>(value | 0x80));
+		this->_M_buffer.push_back(static_cast<char>(value));
+	}
+
+	void _M_string(const std::string &str) {
+		this->_M_varint(str.size());
+		this->_M_buffer.append(str);
+	}
+
+	/* Short printable identifier of a signal in VCD. */
+	void _M_vcd_id(std::size_t index) {
+		do {
+			this->_M_buffer.push_back(static_cast<char>('!' + index % 94));
+			index /= 94;
+		} while (index != 0);
+	}
+
+	/* A[3].b would read as a bit select in VCD, so brackets become parentheses. */
+	void _M_vcd_name(const std::string &name) {
+		for (char c: name)
+			this->_M_buffer.push_back(c == '[' ? '(' : c == ']' ? ')' : c);
+	}
+
+	void _M_header() {
+		if (this->_M_format == Format::Binary) {
+			this->_M_buffer.append(kMagic, sizeof(kMagic));
+			this->_M_varint(this->_M_signals.size());
+			for (auto &signal: this->_M_signals) {
+				this->_M_string(signal.scope);
+				this->_M_string(signal.name);
+				this->_M_varint(signal.width);
+			}
+			return;
+		}
+		this->_M_buffer.append("$timescale 1 ns $end\n");
+		const std::string *scope = nullptr;
+		for (std::size_t i = 0; i < this->_M_signals.size(); ++i) {
+			auto &signal = this->_M_signals[i];
+			if (scope == nullptr || *scope != signal.scope) {
+				if (scope != nullptr) this->_M_buffer.append("$upscope $end\n");
+				scope = &signal.scope;
+				this->_M_buffer.append("$scope module ").append(signal.scope).append(" $end\n");
+			}
+			this->_M_buffer.append("$var wire ").append(std::to_string(signal.width)).push_back(' ');
+			this->_M_vcd_id(i);
+			this->_M_buffer.push_back(' ');
+			this->_M_vcd_name(signal.name);
+			this->_M_buffer.append(" $end\n");
+		}
+		if (scope != nullptr) this->_M_buffer.append("$upscope $end\n");
+		this->_M_buffer.append("$enddefinitions $end\n");
+	}
+
+	void _M_end_block() {
+		if (this->_M_format == Format::Binary && this->_M_started) this->_M_varint(0);
+	}
+
+public:
+	Writer(const std::string &path, Format format)
+		: _M_file(std::fopen(path.c_str(), "wb")), _M_format(format) {
+		if (this->_M_file == nullptr)
+			throw std::runtime_error("Writer: cannot open " + path);
+		this->_M_buffer.reserve(kFlushSize * 2);
+	}
+
+	Writer(const Writer &) = delete;
+	Writer &operator=(const Writer &) = delete;
+
+	~Writer() {
+		if (!this->_M_started) this->_M_header();
+		this->_M_end_block();
+		this->flush();
+		std::fclose(this->_M_file);
+	}
+
+	/* Declare a signal and return its index. All signals must be declared before the first time(). */
+	std::size_t declare(const std::string &scope, const std::string &name, std::size_t width) {
+		if (this->_M_started)
+			throw std::logic_error("Writer: signals must be declared before the first change.");
+		this->_M_signals.push_back({scope, name, width});
+		return this->_M_signals.size() - 1;
+	}
+
+	/* Start the changes at the given cycle, which must not be earlier than the last one. */
+	void time(unsigned long long cycle) {
+		if (!this->_M_started) this->_M_header();
+		else this->_M_end_block();
+		if (this->_M_format == Format::Binary) {
+			this->_M_varint(cycle - this->_M_cycle);
+			this->_M_next = 0;
+		} else {
+			this->_M_buffer.push_back('#');
+			this->_M_buffer.append(std::to_string(cycle)).push_back('\n');
+		}
+		this->_M_started = true;
+		this->_M_cycle = cycle;
+	}
+
+	/* Record a new value. In the binary format, the indices of a cycle must ascend. */
+	void change(std::size_t index, max_size_t value) {
+		if (this->_M_format == Format::Binary) {
+			this->_M_varint(index + 1 - this->_M_next);
+			this->_M_varint(value);
+			this->_M_next = index + 1;
+		} else if (this->_M_signals[index].width == 1) {
+			this->_M_buffer.push_back(value != 0 ? '1' : '0');
+			this->_M_vcd_id(index);
+			this->_M_buffer.push_back('\n');
+		} else {
+			this->_M_buffer.push_back('b');
+			int bit = kMaxLength - 1;
+			while (bit > 0 && (value >> bit & 1) == 0) --bit;
+			for (; bit >= 0; --bit) this->_M_buffer.push_back((value >> bit & 1) != 0 ? '1' : '0');
+			this->_M_buffer.push_back(' ');
+			this->_M_vcd_id(index);
+			this->_M_buffer.push_back('\n');
+		}
+		if (this->_M_buffer.size() >= kFlushSize) this->flush();
+	}
+
+	void flush() {
+		std::fwrite(this->_M_buffer.data(), 1, this->_M_buffer.size(), this->_M_file);
+		this->_M_buffer.clear();
+	}
+};
+
+/* Read a binary waveform written by a Writer, one cycle of changes at a time. */
+class Reader {
+private:
+	std::FILE *_M_file;
+	std::vector<Signal> _M_signals;
+	unsigned long long _M_cycle = 0;
+
+	bool _M_varint(std::uint64_t &value) {
+		value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			const int c = std::fgetc(this->_M_file);
+			if (c == EOF) return false;
+			value |= std::uint64_t(c & 0x7f) << shift;
+			if ((c & 0x80) == 0) return true;
+		}
+		return false;
+	}
+
+	std::uint64_t _M_expect() {
+		std::uint64_t value;
+		if (!this->_M_varint(value))
+			throw std::runtime_error("Reader: unexpected end of the waveform.");
+		return value;
+	}
+
+	std::string _M_string() {
+		std::string str(this->_M_expect(), '\0');
+		if (std::fread(str.data(), 1, str.size(), this->_M_file) != str.size())
+			throw std::runtime_error("Reader: unexpected end of the waveform.");
+		return str;
+	}
+
+public:
+	explicit Reader(const std::string &path) : _M_file(std::fopen(path.c_str(), "rb")) {
+		if (this->_M_file == nullptr)
+			throw std::runtime_error("Reader: cannot open " + path);
+		char magic[sizeof(kMagic)];
+		if (std::fread(magic, 1, sizeof(magic), this->_M_file) != sizeof(magic)
+				|| std::memcmp(magic, kMagic, sizeof(magic)) != 0) {
+			std::fclose(this->_M_file);
+			throw std::runtime_error("Reader: not a waveform file: " + path);
+		}
+		try {
+			this->_M_signals.resize(this->_M_expect());
+			for (auto &signal: this->_M_signals) {
+				signal.scope = this->_M_string();
+				signal.name = this->_M_string();
+				signal.width = this->_M_expect();
+			}
+		} catch (...) {
+			std::fclose(this->_M_file);
+			throw;
+		}
+	}
+
+	Reader(const Reader &) = delete;
+	Reader &operator=(const Reader &) = delete;
+
+	~Reader() { std::fclose(this->_M_file); }
+
+	const std::vector<Signal> &signals() const { return this->_M_signals; }
+
+	/* Read the changes of the next recorded cycle, return false at the end of the file. */
+	bool next(unsigned long long &cycle, std::vector<std::pair<std::size_t, max_size_t>> &changes) {
+		std::uint64_t delta;
+		if (!this->_M_varint(delta)) return false;
+		cycle = this->_M_cycle += delta;
+		changes.clear();
+		std::size_t index = 0;
+		while ((delta = this->_M_expect()) != 0) {
+			index += delta;
+			if (index > this->_M_signals.size())
+				throw std::runtime_error("Reader: signal index out of range.");
+			changes.emplace_back(index - 1, static_cast<max_size_t>(this->_M_expect()));
+		}
+		return true;
+	}
+};
+
+/**
+ * Records the registers and connected wires of modules into a Writer, see CPU::set_waveform.
+ * Only signals whose full name ("ALU.result") contains one of the selected patterns are recorded,
+ * and only in the cycle window; the first recorded cycle holds every value, later ones the changes.
+ */
+class Dumper {
+private:
+	Writer _M_writer;
+	std::vector<Probe> _M_probes;
+	std::vector<max_size_t> _M_values;
+	std::vector<std::string> _M_patterns;
+	std::map<std::string, std::size_t> _M_scopes;
+	unsigned long long _M_begin = 0;
+	unsigned long long _M_end = 0;
+	bool _M_dumped = false;
+
+	bool _M_selected(const std::string &name) const {
+		if (this->_M_patterns.empty()) return true;
+		for (auto &pattern: this->_M_patterns)
+			if (name.find(pattern) != std::string::npos) return true;
+		return false;
+	}
+
+public:
+	explicit Dumper(const std::string &path, Format format = Format::VCD) : _M_writer(path, format) {}
+
+	/* Record only the signals matching one of the patterns. Must be called before add_module. */
+	void select(std::vector<std::string> patterns) { this->_M_patterns = std::move(patterns); }
+
+	/* Record only the cycles in [begin, end). An end of 0 means no end. */
+	void set_window(unsigned long long begin, unsigned long long end = 0) {
+		this->_M_begin = begin;
+		this->_M_end = end;
+	}
+
+	void add_module(ModuleBase &module) {
+		auto scope = profile::type_name(module);
+		if (const auto pos = scope.rfind("::"); pos != std::string::npos)
+			scope.erase(0, pos + 2);
+		if (const auto count = this->_M_scopes[scope]++; count != 0)
+			scope += '_' + std::to_string(count);
+
+		std::vector<Probe> probes;
+		module.probe(probes);
+		for (auto &probe: probes) {
+			if (!this->_M_selected(scope + '.' + probe.name)) continue;
+			this->_M_writer.declare(scope, probe.name, probe.width);
+			this->_M_probes.push_back(std::move(probe));
+		}
+		this->_M_values.resize(this->_M_probes.size());
+	}
+
+	/* Record the values at the end of the given cycle. */
+	void sample(unsigned long long cycle) {
+		if (cycle < this->_M_begin || (this->_M_end != 0 && cycle >= this->_M_end)) return;
+		bool stamped = !this->_M_dumped;
+		if (stamped) this->_M_writer.time(cycle);
+		for (std::size_t i = 0; i < this->_M_probes.size(); ++i) {
+			const auto value = this->_M_probes[i].get();
+			if (this->_M_dumped && value == this->_M_values[i]) continue;
+			if (!stamped) {
+				this->_M_writer.time(cycle);
+				stamped = true;
+			}
+			this->_M_values[i] = value;
+			this->_M_writer.change(i, value);
+		}
+		this->_M_dumped = true;
+	}
+
+	std::size_t size() const { return this->_M_probes.size(); }
+
+	void flush() { this->_M_writer.flush(); }
+};
+
+} // namespace dark::wave
@@ -1,7 +1,11 @@
 #pragma once
 #include "concept.h"
 #include "debug.h"
+#include "register.h"
+#include <atomic>
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace dark {
 
@@ -30,12 +34,23 @@ namespace details {
 		_Cpy_t copy() const override { return new FuncImpl(*this); }
 	};
 
-	struct EmptyWire final : FuncBase {
-		_Ret_t call() const override {
-			debug::assert(false, "Empty wire is called.");
-			debug::unreachable();
-		}
-		_Cpy_t copy() const override { return new EmptyWire; }
+	/**
+	 * Lambda wires cache their value for the epoch they were read in.
+	 * Bumping the epoch invalidates every cached wire at once.
+	 * The counter is per thread, and CPU::run raises it above the last epoch of the CPU,
+	 * so a CPU may be paused on one thread and resumed on another.
+	 */
+	inline thread_local std::size_t wire_epoch = 1;
+
+	/* When set, reading an eager lambda wire also records it here, see CPU::set_eager_wires. */
+	inline thread_local std::vector<const void *> *wire_reads = nullptr;
+
+	/* A lambda wire, type erased for the eager evaluation of CPU. */
+	struct WireNode {
+		std::string name;
+		void *wire;
+		void (*evaluate)(void *);
+		void (*set_eager)(void *, bool);
 	};
 
 } // namespace details
@@ -51,16 +66,24 @@ private:
 
 	using _Manage_t = std::unique_ptr<details::FuncBase>;
 
+	/* Empty until assigned, so that an unconnected wire costs no allocation. */
 	_Manage_t _M_func;
 
-	mutable max_size_t _M_cache : _Len;
-	mutable bool _M_holds;
+	/* Direct-reference source. When set, _M_func is unused. */
+	const Register<_Len> *_M_reg;
+
+	/* Atomic, so that modules working in parallel may share the cache. */
+	mutable std::atomic<max_size_t> _M_cache;
+	mutable std::atomic<std::size_t> _M_epoch;
+
+	/* Evaluated by the CPU before every cycle, so the cache is always valid. */
+	bool _M_eager;
 
 	[[no_unique_address]]
 	debug::DebugValue<bool, false> _M_assigned;
 
 private:
-	void sync() { this->_M_holds = false; }
+	void sync() { this->_M_epoch.store(0, std::memory_order_relaxed); }
   friend class CPU;
 
 	template<details::WireFunction<_Len> _Fn>
@@ -69,6 +92,26 @@ private:
 		return new details::FuncImpl<_Len, _Decay_t>{std::forward<_Fn>(fn)};
 	}
 
+	/* Whether reading the wire is meaningful, i.e. it has been assigned. */
+	bool _M_connected() const {
+		return this->_M_reg != nullptr || this->_M_func != nullptr;
+	}
+
+	static void _M_evaluate(void *ptr) {
+		auto &wire = *static_cast<Wire *>(ptr);
+		wire._M_cache.store(wire._M_func->call() & make_mask<_Len>(), std::memory_order_relaxed);
+	}
+
+	static void _M_set_eager(void *ptr, bool eager) {
+		auto &wire = *static_cast<Wire *>(ptr);
+		wire._M_eager = eager;
+		wire.sync();
+	}
+
+	details::WireNode _M_node(std::string name) {
+		return {std::move(name), this, &Wire::_M_evaluate, &Wire::_M_set_eager};
+	}
+
 	void _M_checked_assign() {
 		debug::assert(!this->_M_assigned, "Wire is assigned twice.");
 		this->_M_assigned = true;
@@ -77,18 +120,29 @@ private:
 public:
 	static constexpr std::size_t _Bit_Len = _Len;
 
-	Wire() : _M_func(new details::EmptyWire),
-			 _M_cache(), _M_holds(), _M_assigned() {}
+	Wire() : _M_func(), _M_reg(),
+			 _M_cache(), _M_epoch(), _M_eager(), _M_assigned() {}
 
 	explicit operator max_size_t() const {
     #ifdef _DEBUG
     debug::assert(this->_M_assigned, "Wire is not assigned.");
     #endif
-		if (this->_M_holds == false) {
-			this->_M_holds = true;
-			this->_M_cache = this->_M_func->call();
+		if (this->_M_reg != nullptr)
+			return static_cast<max_size_t>(*this->_M_reg);
+		debug::assert(this->_M_func != nullptr, "Empty wire is called.");
+		if (this->_M_eager) {
+			if (auto *reads = details::wire_reads) [[unlikely]]
+				reads->push_back(this);
+			return this->_M_cache.load(std::memory_order_relaxed);
+		}
+		const auto epoch = details::wire_epoch;
+		if (this->_M_epoch.load(std::memory_order_acquire) != epoch) {
+			const max_size_t value = this->_M_func->call() & make_mask<_Len>();
+			this->_M_cache.store(value, std::memory_order_relaxed);
+			this->_M_epoch.store(epoch, std::memory_order_release);
+			return value;
 		}
-		return this->_M_cache;
+		return this->_M_cache.load(std::memory_order_relaxed);
 	}
 
 	Wire(Wire &&) = delete;
@@ -97,8 +151,12 @@ public:
 	Wire &operator=(const Wire &rhs) = delete;
 
 	template<details::WireFunction<_Len> _Fn>
-	Wire(_Fn &&fn) : _M_func(_M_new_func(std::forward<_Fn>(fn))),
-					 _M_cache(), _M_holds(), _M_assigned() {}
+	Wire(_Fn &&fn) : _M_func(_M_new_func(std::forward<_Fn>(fn))), _M_reg(),
+					 _M_cache(), _M_epoch(), _M_eager(), _M_assigned() {}
+
+	/* Connect the wire directly to a register, without a lambda in between. */
+	Wire(const Register<_Len> &reg) : _M_func(), _M_reg(&reg),
+									  _M_cache(), _M_epoch(), _M_eager(), _M_assigned() {}
 
 	template<details::WireFunction<_Len> _Fn>
 	Wire &operator=(_Fn &&fn) {
@@ -109,9 +167,20 @@ public:
 	void assign(_Fn &&fn) {
 		this->_M_checked_assign();
 		this->_M_func.reset(_M_new_func(std::forward<_Fn>(fn)));
+		this->_M_reg = nullptr;
 		this->sync();
 	}
 
+	Wire &operator=(const Register<_Len> &reg) {
+		return this->assign(reg), *this;
+	}
+
+	void assign(const Register<_Len> &reg) {
+		this->_M_checked_assign();
+		this->_M_func.reset();
+		this->_M_reg = &reg;
+	}
+
 	explicit operator bool() const {
 		return static_cast<max_size_t>(*this);
 	}
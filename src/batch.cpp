@@ -0,0 +1,58 @@
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "batch.h"
+#include "machine.h"
+// run many programs on independent machines over a pool of threads, see docs/help.md
+int main(int argc, char **argv) {
+  unsigned long long max_cycles = 0;
+  std::size_t threads = 1;
+  std::vector<std::string> programs;
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg.starts_with("--threads=")) {
+      threads = std::stoul(std::string(arg.substr(10)));
+      if (threads == 0) threads = std::thread::hardware_concurrency();
+    } else if (arg.starts_with("--max-cycles=")) {
+      max_cycles = std::stoull(std::string(arg.substr(13)));
+    } else if (!arg.starts_with("--")) {
+      programs.emplace_back(arg);
+    } else {
+      programs.clear();
+      break;
+    }
+  }
+  if (programs.empty()) {
+    std::cerr << "Usage: " << argv[0] << " [--threads=T] [--max-cycles=N] program..." << std::endl;
+    return 1;
+  }
+  dark::Batch<ZYM::Machine> batch;
+  for (auto &program : programs) {
+    std::ifstream fin(program);
+    if (!fin) {
+      std::cerr << "cannot open " << program << std::endl;
+      return 1;
+    }
+    auto &machine = batch.add();
+    machine.csu.report_predictions = false;
+    machine.memory.LoadProgram(fin);
+  }
+  batch.run(threads, max_cycles);
+  bool all_halted = true;
+  for (std::size_t i = 0; i < batch.size(); i++) {
+    auto &lane = batch[i];
+    std::cout << programs[i] << ": ";
+    if (lane.halted) {
+      std::cout << "exit code " << uint32_t(lane.exit_code);
+    } else {
+      std::cout << "no exit";
+      all_halted = false;
+    }
+    std::cout << " after " << lane.machine->cpu.cycles << " cycles" << std::endl;
+  }
+  return all_halted ? 0 : 1;
+}
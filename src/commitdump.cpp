@@ -0,0 +1,31 @@
+#include <cstdio>
+#include <exception>
+#include <iostream>
+#include <string_view>
+#include "commitlog.h"
+// decode a commit log written by the interpreter with --commit-log, by default as the old text log
+int main(int argc, char **argv) {
+  bool full = argc == 3 && std::string_view(argv[1]) == "--full";
+  if (argc != 2 && !full) {
+    std::cerr << "Usage: " << argv[0] << " [--full] <commit log>" << std::endl;
+    return 1;
+  }
+  try {
+    dark::commitlog::Reader reader(argv[argc - 1]);
+    dark::commitlog::Record record;
+    while (reader.next(record)) {
+      if (!full) {
+        std::printf("csu is committing instruct %08X\n", record.instruction);
+        continue;
+      }
+      std::printf("%08x %08x", record.pc, record.instruction);
+      if (record.flags & dark::commitlog::kWritesRd) std::printf(" x%u=%08x", record.rd, record.value);
+      if (record.flags & dark::commitlog::kMemory) std::printf(" mem[%08x]=%08x", record.addr, record.data);
+      std::printf("\n");
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
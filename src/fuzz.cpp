@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "machine.h"
+// run one program under many module orders, see docs/help.md
+namespace {
+struct Outcome {
+  uint32_t exit_code;
+  unsigned long long cycles;
+};
+// the reference uses run_once, the seeds run_once_shuffle
+Outcome Run(const std::vector<uint8_t> &image, bool shuffle, unsigned int seed, unsigned long long max_cycles) {
+  auto machine = std::make_unique<ZYM::Machine>();
+  machine->csu.report_predictions = false;
+  machine->memory.LoadProgram(image);
+  machine->cpu.set_shuffle_seed(seed);
+  uint8_t exit_code = machine->cpu.run(max_cycles, shuffle);
+  return {exit_code, machine->cpu.cycles};
+}
+// every register and connected wire of a machine, named as in waveforms
+std::vector<dark::Probe> ProbeAll(ZYM::Machine &machine) {
+  std::vector<dark::Probe> probes;
+  dark::ModuleBase *modules[] = {&machine.csu, &machine.memory, &machine.lsq, &machine.alu, &machine.rf, &machine.rs};
+  for (auto *module : modules) {
+    auto first = probes.size();
+    module->probe(probes);
+    auto scope = dark::profile::type_name(*module);
+    for (auto i = first; i < probes.size(); i++) probes[i].name = scope + '.' + probes[i].name;
+  }
+  return probes;
+}
+// replay the reference and a seed cycle by cycle, and report where they first differ
+void Locate(const std::vector<uint8_t> &image, unsigned int seed, unsigned long long max_cycles) {
+  auto reference = std::make_unique<ZYM::Machine>();
+  auto shuffled = std::make_unique<ZYM::Machine>();
+  for (auto *machine : {reference.get(), shuffled.get()}) {
+    machine->csu.report_predictions = false;
+    machine->memory.LoadProgram(image);
+  }
+  shuffled->cpu.set_shuffle_seed(seed);
+  auto reference_probes = ProbeAll(*reference);
+  auto shuffled_probes = ProbeAll(*shuffled);
+  for (unsigned long long cycle = 1; cycle <= max_cycles; cycle++) {
+    reference->cpu.run(cycle, false);
+    shuffled->cpu.run(cycle, true);
+    for (size_t i = 0; i < reference_probes.size(); i++) {
+      auto expected = reference_probes[i].get();
+      auto actual = shuffled_probes[i].get();
+      if (expected != actual) {
+        std::cout << "seed " << seed << " first diverges at cycle " << cycle << ": " << reference_probes[i].name
+                  << " is " << actual << ", expected " << expected << std::endl;
+        return;
+      }
+    }
+    bool reference_halted = static_cast<dark::max_size_t>(reference->cpu.halt_signal) >> 8 & 1;
+    bool shuffled_halted = static_cast<dark::max_size_t>(shuffled->cpu.halt_signal) >> 8 & 1;
+    if (reference_halted != shuffled_halted) {
+      std::cout << "seed " << seed << (shuffled_halted ? " halts" : " does not halt") << " at cycle " << cycle
+                << ", with the same signals" << std::endl;
+      return;
+    }
+    if (reference_halted) break;
+  }
+  std::cout << "seed " << seed << " does not diverge in the signals" << std::endl;
+}
+}  // namespace
+int main(int argc, char **argv) {
+  unsigned int first_seed = 1, seeds = 64;
+  unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg.starts_with("--seeds=")) {
+      seeds = std::stoul(std::string(arg.substr(8)));
+    } else if (arg.starts_with("--first-seed=")) {
+      first_seed = std::stoul(std::string(arg.substr(13)));
+    } else if (arg.starts_with("--threads=")) {
+      threads = std::max(1ul, std::stoul(std::string(arg.substr(10))));
+    } else {
+      std::cerr << "Usage: " << argv[0] << " [--seeds=N] [--first-seed=S] [--threads=T] < program" << std::endl;
+      return 1;
+    }
+  }
+  auto image = ZYM::Memory::ParseProgram(std::cin);
+  auto expected = Run(image, false, 0, 0);
+  std::cout << "reference: exit code " << expected.exit_code << " after " << expected.cycles << " cycles" << std::endl;
+  // a diverging seed may never halt, so it gets twice the cycles of the reference
+  auto max_cycles = expected.cycles * 2 + 1000;
+
+  std::vector<Outcome> outcomes(seeds);
+  std::atomic<unsigned int> next(0);
+  std::vector<std::thread> pool;
+  for (unsigned int t = 0; t < std::min(threads, seeds); t++) {
+    pool.emplace_back([&] {
+      for (unsigned int i; (i = next.fetch_add(1)) < seeds;) {
+        outcomes[i] = Run(image, true, first_seed + i, max_cycles);
+      }
+    });
+  }
+  for (auto &thread : pool) thread.join();
+
+  unsigned int diverged = 0;
+  for (unsigned int i = 0; i < seeds; i++) {
+    if (outcomes[i].exit_code == expected.exit_code && outcomes[i].cycles == expected.cycles) continue;
+    if (diverged++ == 0) {
+      std::cout << "seed " << first_seed + i << ": exit code " << outcomes[i].exit_code << " after "
+                << outcomes[i].cycles << " cycles" << std::endl;
+      Locate(image, first_seed + i, max_cycles);
+    }
+  }
+  std::cout << seeds << " seeds, " << diverged << " diverged" << std::endl;
+  return diverged == 0 ? 0 : 1;
+}
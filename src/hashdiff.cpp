@@ -0,0 +1,34 @@
+#include <exception>
+#include <iostream>
+#include <vector>
+#include "statehash.h"
+// compare two state hash files written with --state-hash, see docs/help.md
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " <hashes> <hashes>" << std::endl;
+    return 2;
+  }
+  std::vector<dark::hash::Sample> lhs, rhs;
+  try {
+    lhs = dark::hash::read(argv[1]);
+    rhs = dark::hash::read(argv[2]);
+  } catch (const std::exception &e) {
+    // 1 means the runs diverged
+    std::cerr << e.what() << std::endl;
+    return 2;
+  }
+  auto divergence = dark::hash::bisect(lhs, rhs);
+  if (!divergence.found) {
+    std::cout << "identical, " << lhs.size() << " samples" << std::endl;
+    return 0;
+  }
+  std::cout << "first divergent sample at cycle " << divergence.first_different;
+  if (divergence.last_equal != 0) std::cout << ", last equal at cycle " << divergence.last_equal;
+  std::cout << std::endl;
+  if (divergence.first_different - divergence.last_equal > 1) {
+    // narrow it down to one cycle by recording every cycle in between
+    std::cout << "rerun both with --state-hash=<file>,1 --state-hash-cycles=" << divergence.last_equal << ','
+              << divergence.first_different + 1 << std::endl;
+  }
+  return 1;
+}
@@ -1,175 +1,173 @@
+#include <algorithm>
+#include <fstream>
 #include <iostream>
-#include "alu.h"
-#include "csu.h"
-#include "loadstorequeue.h"
-#include "memory.h"
-#include "registerfile.h"
-#include "reservestation.h"
-#include "tools.h"
-unsigned int global_clock = 0;
-template <std::size_t N>
-inline static void RWConnect(dark::Register<N> &src, dark::Wire<N> &dest) {
-  dest.assign([&]() -> auto & { return src; });
-}
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "machine.h"
 int main(int argc, char **argv) {
-  dark::CPU cpu;
-  ZYM::CentralScheduleUnit csu;
-  ZYM::Memory memory;
-  ZYM::LoadStoreQueue lsq;
-  ZYM::ALU alu;
-  ZYM::RegisterFile rf;
-  ZYM::ReserveStation rs;
-  cpu.add_module(&csu);
-  cpu.add_module(&memory);
-  cpu.add_module(&lsq);
-  cpu.add_module(&alu);
-  cpu.add_module(&rf);
-  cpu.add_module(&rs);
-  // some basic siganls
-  cpu.halt_signal.assign([&]() -> auto & { return csu.halt_signal; });
-  csu.SetInstructionFetcher([&](auto addr) { return memory.FetchInstruction(addr); });
-  csu.reset.assign([&]() { return cpu.GetResetSignal(); });
-  memory.reset.assign([&]() { return cpu.GetResetSignal(); });
-  memory.LoadProgram(std::cin);
-  lsq.reset.assign([&]() { return cpu.GetResetSignal(); });
-  // alu.reset.assign([&]() { return cpu.GetResetSignal(); });
-  rf.reset.assign([&]() { return cpu.GetResetSignal(); });
-  rs.reset.assign([&]() { return cpu.GetResetSignal(); });
-  csu.a0.assign([&]() { return rf.ReturnExitCodeImmediately(); });
-  // now connect the wires, see the comment and docs for help
-  // csu <-> memory
-  RWConnect(csu.force_clear_announcer, memory.force_clear_receiver);
-  RWConnect(csu.is_committing, memory.is_committing);
-  RWConnect(csu.commit_ins_ROB_index, memory.commit_ins_ROB_index);
-  RWConnect(memory.data_sign, csu.mem_status_receiver);
-  RWConnect(memory.completed_memins_ROB_index, csu.completed_memins_ROB_index);
-  RWConnect(memory.completed_memins_read_data, csu.completed_memins_read_data);
-  // csu <-> lsq
-  RWConnect(csu.force_clear_announcer, lsq.force_clear_receiver);
-  RWConnect(csu.is_issuing, lsq.is_issuing);
-  RWConnect(csu.issue_type, lsq.issue_type);
-  RWConnect(csu.issue_ROB_index, lsq.issue_ROB_index);
-  RWConnect(csu.full_ins_id, lsq.full_ins_id);
-  RWConnect(csu.full_ins, lsq.full_ins);
-  RWConnect(csu.issuing_PC, lsq.issuing_PC);
-  RWConnect(csu.decoded_rd, lsq.decoded_rd);
-  RWConnect(csu.has_decoded_rd, lsq.has_decoded_rd);
-  RWConnect(csu.decoded_rs1, lsq.decoded_rs1);
-  RWConnect(csu.has_decoded_rs1, lsq.has_decoded_rs1);
-  RWConnect(csu.rs1_is_in_ROB, lsq.rs1_is_in_ROB);
-  RWConnect(csu.rs1_in_ROB_value, lsq.rs1_in_ROB_value);
-  RWConnect(csu.decoded_rs2, lsq.decoded_rs2);
-  RWConnect(csu.has_decoded_rs2, lsq.has_decoded_rs2);
-  RWConnect(csu.rs2_is_in_ROB, lsq.rs2_is_in_ROB);
-  RWConnect(csu.rs2_in_ROB_value, lsq.rs2_in_ROB_value);
-  RWConnect(csu.decoded_imm, lsq.decoded_imm);
-  // RWConnect(csu.cache_hit, lsq.cache_hit);
-  // RWConnect(csu.cache_hit_ROB_index, lsq.cache_hit_ROB_index);
-  // RWConnect(csu.cache_hit_data, lsq.cache_hit_data);
-  RWConnect(lsq.mem_request_full_ins_id, csu.mem_request_full_ins_id);
-  RWConnect(lsq.request_type_output, csu.mem_request_type_input);
-  RWConnect(lsq.request_ROB_index, csu.mem_request_ROB_index);
-  RWConnect(lsq.request_address_output, csu.mem_address_input);
-  RWConnect(lsq.request_data_output, csu.mem_data_input);
-  RWConnect(lsq.LSQ_remain_space_output, csu.load_store_queue_emptyspace_receiver);
-  // csu <-> alu
-  RWConnect(alu.alu_status, csu.alu_status_receiver);
-  RWConnect(alu.result_ROB_index, csu.completed_aluins_ROB_index);
-  RWConnect(alu.result, csu.completed_aluins_result);
-  RWConnect(alu.completed_alu_resulting_PC, csu.completed_alu_resulting_PC);
-  // csu <-> register file
-  RWConnect(csu.force_clear_announcer, rf.force_clear_receiver);
-  RWConnect(csu.is_issuing, rf.is_issuing);
-  RWConnect(csu.issue_type, rf.issue_type);
-  RWConnect(csu.issue_ROB_index, rf.issue_ROB_index);
-  RWConnect(csu.full_ins_id, rf.full_ins_id);
-  RWConnect(csu.full_ins, rf.full_ins);
-  RWConnect(csu.decoded_rd, rf.decoded_rd);
-  RWConnect(csu.has_decoded_rd, rf.has_decoded_rd);
-  RWConnect(csu.decoded_rs1, rf.decoded_rs1);
-  RWConnect(csu.has_decoded_rs1, rf.has_decoded_rs1);
-  RWConnect(csu.decoded_rs2, rf.decoded_rs2);
-  RWConnect(csu.has_decoded_rs2, rf.has_decoded_rs2);
-  // RWConnect(rf.rs1_nodep, csu.rs1_nodep);
-  // RWConnect(rf.rs1_deps, csu.rs1_deps);
-  // RWConnect(rf.rs2_nodep, csu.rs2_nodep);
-  // RWConnect(rf.rs2_deps, csu.rs2_deps);
-  RWConnect(csu.is_committing, rf.is_committing);
-  RWConnect(csu.commit_has_resulting_register, rf.has_resulting_register);
-  RWConnect(csu.commit_reg_index, rf.commit_reg_index);
-  RWConnect(csu.commit_reg_value, rf.commit_reg_value);
-  RWConnect(csu.commit_ins_ROB_index, rf.commit_ins_ROB_index);
-  // csu <-> reserve station
-  RWConnect(csu.force_clear_announcer, rs.force_clear_receiver);
-  RWConnect(csu.is_issuing, rs.is_issuing);
-  RWConnect(csu.issue_type, rs.issue_type);
-  RWConnect(csu.issue_ROB_index, rs.issue_ROB_index);
-  RWConnect(csu.full_ins_id, rs.full_ins_id);
-  RWConnect(csu.full_ins, rs.full_ins);
-  RWConnect(csu.issuing_PC, rs.issuing_PC);
-  RWConnect(csu.decoded_rd, rs.decoded_rd);
-  RWConnect(csu.has_decoded_rd, rs.has_decoded_rd);
-  RWConnect(csu.decoded_rs1, rs.decoded_rs1);
-  RWConnect(csu.has_decoded_rs1, rs.has_decoded_rs1);
-  RWConnect(csu.rs1_is_in_ROB, rs.rs1_is_in_ROB);
-  RWConnect(csu.rs1_in_ROB_value, rs.rs1_in_ROB_value);
-  RWConnect(csu.decoded_rs2, rs.decoded_rs2);
-  RWConnect(csu.has_decoded_rs2, rs.has_decoded_rs2);
-  RWConnect(csu.rs2_is_in_ROB, rs.rs2_is_in_ROB);
-  RWConnect(csu.rs2_in_ROB_value, rs.rs2_in_ROB_value);
-  RWConnect(csu.decoded_imm, rs.decoded_imm);
-  RWConnect(csu.decoded_shamt, rs.decoded_shamt);
-  // RWConnect(csu.cache_hit, rs.cache_hit);
-  // RWConnect(csu.cache_hit_ROB_index, rs.cache_hit_ROB_index);
-  // RWConnect(csu.cache_hit_data, rs.cache_hit_data);
-  RWConnect(rs.RS_remain_space_output, csu.reservestation_emptyspace_receiver);
-  // memory <-> lsq
-  RWConnect(memory.data_sign, lsq.mem_data_sign);
-  RWConnect(memory.completed_memins_ROB_index, lsq.completed_memins_ROB_index);
-  RWConnect(memory.completed_memins_read_data, lsq.completed_memins_read_data);
-  RWConnect(lsq.mem_request_full_ins_id, memory.full_ins_id);
-  RWConnect(lsq.request_type_output, memory.request_type_input);
-  RWConnect(lsq.request_ROB_index, memory.request_ROB_index);
-  RWConnect(lsq.request_address_output, memory.address_input);
-  RWConnect(lsq.request_data_output, memory.data_input);
-  // memory <-> alu : no connections
-  // memory <-> register file : no connections
-  // memory <-> reserve station :
-  RWConnect(memory.data_sign, rs.mem_status_receiver);
-  RWConnect(memory.completed_memins_ROB_index, rs.completed_memins_ROB_index);
-  RWConnect(memory.completed_memins_read_data, rs.completed_memins_read_data);
-  // lsq <-> alu :
-  RWConnect(alu.alu_status, lsq.alu_status_receiver);
-  RWConnect(alu.result_ROB_index, lsq.completed_aluins_ROB_index);
-  RWConnect(alu.result, lsq.completed_aluins_result);
-  // lsq <-> register file
-  RWConnect(rf.rs1_nodep, lsq.rs1_nodep);
-  RWConnect(rf.rs1_deps, lsq.rs1_deps);
-  RWConnect(rf.rs1_value, lsq.rs1_value);
-  RWConnect(rf.rs2_nodep, lsq.rs2_nodep);
-  RWConnect(rf.rs2_deps, lsq.rs2_deps);
-  RWConnect(rf.rs2_value, lsq.rs2_value);
-  // lsq <-> reserve station : no connections
-  // alu <-> register file : no connections
-  // alu <-> reserve station
-  RWConnect(rs.request_full_id, alu.request_full_id);
-  RWConnect(rs.operand1, alu.operand1);
-  RWConnect(rs.operand2, alu.operand2);
-  RWConnect(rs.request_ROB_index, alu.request_ROB_index);
-  RWConnect(rs.alu_ins_PC, alu.request_PC);
-  RWConnect(rs.op_imm, alu.imm);
-  RWConnect(rs.op_shamt, alu.shamt);
-  RWConnect(alu.alu_status, rs.alu_status_receiver);
-  RWConnect(alu.result_ROB_index, rs.completed_aluins_ROB_index);
-  RWConnect(alu.result, rs.completed_aluins_result);
-  // register file <-> reserve station
-  RWConnect(rf.rs1_nodep, rs.rs1_nodep);
-  RWConnect(rf.rs1_deps, rs.rs1_deps);
-  RWConnect(rf.rs1_value, rs.rs1_value);
-  RWConnect(rf.rs2_nodep, rs.rs2_nodep);
-  RWConnect(rf.rs2_deps, rs.rs2_deps);
-  RWConnect(rf.rs2_value, rs.rs2_value);
-  // now start running
-  std::cout << uint32_t(cpu.run(0, false)) << std::endl;
+  auto image = ZYM::Memory::ParseProgram(std::cin);
+  if (argc == 2 && std::string_view(argv[1]) == "--static") {
+    // the statically dispatched machine takes no other option
+    ZYM::StaticMachine machine;
+    machine.memory.LoadProgram(image);
+    std::cout << uint32_t(machine.cpu.run()) << std::endl;
+    return 0;
+  }
+  ZYM::Machine machine;
+  dark::CPU &cpu = machine.cpu;
+  machine.memory.LoadProgram(image);
+  unsigned long long checkpoint_cycles = 0;
+  std::string checkpoint_file;
+  bool profiling = false, gating = false;
+  std::unique_ptr<dark::trace::Tracer> tracer;
+  std::string wave_file;
+  std::string stats_file;
+  double heartbeat_interval = 0, heartbeat_floor = 0;
+  std::string heartbeat_file;
+  std::vector<std::string> wave_signals;
+  unsigned long long wave_begin = 0, wave_end = 0;
+  std::string hash_file;
+  unsigned long threads = 1;
+  unsigned long long hash_interval = 1, hash_begin = 0, hash_end = 0;
+  // command line options
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg.starts_with("--threads=")) {
+      try {
+        cpu.set_threads(threads = std::stoul(std::string(arg.substr(10))));
+      } catch (const std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+      }
+    } else if (arg == "--gating") {
+      cpu.set_clock_gating(gating = true);
+    } else if (arg == "--gating=verify") {
+      cpu.set_clock_gating(gating = true, true);
+    } else if (arg == "--profile") {
+      cpu.set_profiling(profiling = true);
+    } else if (arg == "--profile=perf") {
+      cpu.set_profiling(profiling = true, true);
+    } else if (arg.starts_with("--trace=")) {
+      // decode the file with tracedump
+      tracer = std::make_unique<dark::trace::Tracer>(std::string(arg.substr(8)));
+      tracer->attach();
+    } else if (arg.starts_with("--wave=")) {
+      // VCD if the file name ends with .vcd, the binary format otherwise
+      wave_file = arg.substr(7);
+    } else if (arg.starts_with("--wave-signals=")) {
+      // comma separated patterns, e.g. --wave-signals=ALU.,rs1
+      for (auto list = arg.substr(15); !list.empty();) {
+        auto comma = std::min(list.find(','), list.size());
+        if (comma != 0) wave_signals.emplace_back(list.substr(0, comma));
+        list.remove_prefix(std::min(comma + 1, list.size()));
+      }
+    } else if (arg.starts_with("--wave-cycles=") && arg.find(',') != arg.npos) {
+      // --wave-cycles=<begin>,<end>: record the cycles in [begin, end), an empty end means no end
+      wave_begin = std::stoull(std::string(arg.substr(14, arg.find(',') - 14)));
+      auto end = arg.substr(arg.find(',') + 1);
+      wave_end = end.empty() ? 0 : std::stoull(std::string(end));
+    } else if (arg.starts_with("--state-hash=")) {
+      // --state-hash=<file>[,<interval>]: record the state hash every interval cycles, compare with hashdiff
+      auto value = arg.substr(13);
+      hash_file = value.substr(0, value.find(','));
+      if (value.find(',') != value.npos) hash_interval = std::stoull(std::string(value.substr(value.find(',') + 1)));
+    } else if (arg.starts_with("--state-hash-cycles=") && arg.find(',') != arg.npos) {
+      // same as --wave-cycles
+      hash_begin = std::stoull(std::string(arg.substr(20, arg.find(',') - 20)));
+      auto end = arg.substr(arg.find(',') + 1);
+      hash_end = end.empty() ? 0 : std::stoull(std::string(end));
+    } else if (arg.starts_with("--stats=")) {
+      // CSV if the file name ends with .csv, JSON otherwise
+      stats_file = arg.substr(8);
+    } else if (arg.starts_with("--heartbeat=")) {
+      // report the simulation speed every given number of seconds
+      heartbeat_interval = std::stod(std::string(arg.substr(12)));
+    } else if (arg.starts_with("--heartbeat-file=")) {
+      heartbeat_file = arg.substr(17);
+    } else if (arg.starts_with("--min-speed=")) {
+      // abort when an interval of the heartbeat simulates fewer cycles per second
+      heartbeat_floor = std::stod(std::string(arg.substr(12)));
+    } else if (arg == "--eager-wires") {
+      cpu.set_eager_wires(true);
+    } else if (arg.starts_with("--checkpoint=") && arg.find(',') != arg.npos) {
+      // --checkpoint=<cycles>,<file>: save the state after the given number of cycles
+      checkpoint_cycles = std::stoull(std::string(arg.substr(13, arg.find(',') - 13)));
+      checkpoint_file = arg.substr(arg.find(',') + 1);
+    } else if (arg.starts_with("--restore=")) {
+      std::ifstream fin(std::string(arg.substr(10)), std::ios::binary);
+      if (!fin) {
+        std::cerr << "Cannot open checkpoint: " << arg.substr(10) << std::endl;
+        return 1;
+      }
+      cpu.load(fin);
+    } else {
+      std::cerr << "Unknown option: " << arg << std::endl;
+      return 1;
+    }
+  }
+  if (int(threads > 1) + int(gating) + int(profiling) > 1) {
+    // each of them replaces the cycle loop of the CPU
+    std::cerr << "Choose one of --threads, --gating and --profile" << std::endl;
+    return 1;
+  }
+  if (tracer != nullptr && threads > 1) {
+    // only this thread is attached, so events of the modules on the workers would be lost
+    std::cerr << "--trace cannot be used with --threads" << std::endl;
+    return 1;
+  }
+  std::unique_ptr<dark::wave::Dumper> dumper;
+  if (!wave_file.empty()) {
+    auto format = wave_file.ends_with(".vcd") ? dark::wave::Format::VCD : dark::wave::Format::Binary;
+    dumper = std::make_unique<dark::wave::Dumper>(wave_file, format);
+    dumper->select(wave_signals);
+    dumper->set_window(wave_begin, wave_end);
+    cpu.set_waveform(dumper.get());
+  }
+  std::unique_ptr<dark::hash::Recorder> recorder;
+  if (!hash_file.empty()) {
+    recorder = std::make_unique<dark::hash::Recorder>(hash_file, hash_interval);
+    recorder->set_window(hash_begin, hash_end);
+    cpu.set_state_hash(recorder.get());
+  }
+  std::ofstream heartbeat_out;
+  std::unique_ptr<dark::Heartbeat> heartbeat;
+  if (heartbeat_interval > 0 || heartbeat_floor > 0) {
+    if (!heartbeat_file.empty()) heartbeat_out.open(heartbeat_file);
+    heartbeat = std::make_unique<dark::Heartbeat>(heartbeat_file.empty() ? std::cerr : heartbeat_out,
+                                                  heartbeat_interval > 0 ? heartbeat_interval : 1, heartbeat_floor);
+    heartbeat->set_instructions([&machine] { return machine.csu.CommittedInstructions(); });
+    heartbeat->set_pc([&machine] { return machine.csu.CommittedPC(); });
+    // --min-speed alone checks the speed every second without printing it
+    heartbeat->set_reporting(heartbeat_interval > 0);
+    cpu.set_heartbeat(heartbeat.get());
+  }
+  // now start running; a heartbeat below --min-speed stops the run, and returning lets every writer flush
+  try {
+    if (!checkpoint_file.empty()) {
+      uint8_t exit_code = cpu.run(checkpoint_cycles, false);
+      if (static_cast<max_size_t>(cpu.halt_signal) & (1 << 8)) {
+        std::cout << uint32_t(exit_code) << std::endl;
+        return 0;
+      }
+      std::ofstream fout(checkpoint_file, std::ios::binary);
+      cpu.save(fout);
+    }
+    std::cout << uint32_t(cpu.run(0, false)) << std::endl;
+  } catch (const std::runtime_error &e) {
+    std::cerr << e.what() << std::endl;
+    return 2;
+  }
+  if (profiling) cpu.print_profile(std::cerr);
+  if (!stats_file.empty()) {
+    std::ofstream fout(stats_file);
+    if (stats_file.ends_with(".csv")) {
+      cpu.counters.write_csv(fout);
+    } else {
+      cpu.counters.write_json(fout);
+    }
+  }
   return 0;
 }
\ No newline at end of file
@@ -7,8 +7,18 @@
 #include <ios>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
+#include "commitlog.h"
+#if defined(__x86_64__) && defined(__linux__)
+#define RV32I_JIT
+#include <sys/mman.h>
+#endif
 #ifdef DEBUG
 #define DEBUG_CERR std::cerr
 #else
@@ -70,7 +80,8 @@ std::map<std::pair<uint8_t, uint8_t>, ExecuteFunc> ExecuteFuncMap = {
     {{0x33, 8}, Execute_sub},   {{0x33, 1}, Execute_sll},   {{0x33, 2}, Execute_slt},   {{0x33, 3}, Execute_sltu},
     {{0x33, 4}, Execute_xor},   {{0x33, 5}, Execute_srl},   {{0x33, 13}, Execute_sra},  {{0x33, 6}, Execute_or},
     {{0x33, 7}, Execute_and}};
-ExecuteFunc Decode(uint32_t instr) {
+// the key of an instruction in ExecuteFuncMap: opcode and funct3, plus bit 30 (and 31) of funct7 for shifts and R type
+std::pair<uint8_t, uint8_t> DecodeKey(uint32_t instr) {
   uint8_t opcode = instr & 127;
   uint8_t funct3 = (instr >> 12) & 7;
   uint8_t funct7 = (instr >> 25) & 127;
@@ -83,11 +94,90 @@ ExecuteFunc Decode(uint32_t instr) {
   uint8_t second_key = funct3 | (funct7 << 3);
   DEBUG_CERR << "Decoding, opcode=" << std::hex << (int)opcode << " second_key=" << std::dec << (int)second_key
              << std::endl;
-  if (ExecuteFuncMap.find({opcode, second_key}) == ExecuteFuncMap.end()) {
+  return {opcode, second_key};
+}
+ExecuteFunc Decode(uint32_t instr) {
+  auto key = DecodeKey(instr);
+  if (ExecuteFuncMap.find(key) == ExecuteFuncMap.end()) {
     throw std::runtime_error("Unsupported instruction");
   }
-  return ExecuteFuncMap[{opcode, second_key}];
+  return ExecuteFuncMap[key];
 }
+// every instruction with its key in ExecuteFuncMap, the format of its immediate and its predecoded handler
+#define RV32I_INSTRUCTIONS(X)                                     \
+  X(LUI, 0x37, 0, U, PredecodedOps::Lui)                          \
+  X(AUIPC, 0x17, 0, U, PredecodedOps::Auipc)                      \
+  X(JAL, 0x6F, 0, J, PredecodedOps::Jal)                          \
+  X(JALR, 0x67, 0, I, PredecodedOps::Jalr)                        \
+  X(BEQ, 0x63, 0, B, PredecodedOps::B<Eq>)                        \
+  X(BNE, 0x63, 1, B, PredecodedOps::B<Ne>)                        \
+  X(BLT, 0x63, 4, B, PredecodedOps::B<Lt>)                        \
+  X(BGE, 0x63, 5, B, PredecodedOps::B<Ge>)                        \
+  X(BLTU, 0x63, 6, B, PredecodedOps::B<Ltu>)                      \
+  X(BGEU, 0x63, 7, B, PredecodedOps::B<Geu>)                      \
+  X(LB, 0x03, 0, I, (PredecodedOps::Load<uint8_t, true>))         \
+  X(LH, 0x03, 1, I, (PredecodedOps::Load<uint16_t, true>))        \
+  X(LW, 0x03, 2, I, (PredecodedOps::Load<uint32_t, false>))       \
+  X(LBU, 0x03, 4, I, (PredecodedOps::Load<uint8_t, false>))       \
+  X(LHU, 0x03, 5, I, (PredecodedOps::Load<uint16_t, false>))      \
+  X(SB, 0x23, 0, S, PredecodedOps::Store<uint8_t>)                \
+  X(SH, 0x23, 1, S, PredecodedOps::Store<uint16_t>)               \
+  X(SW, 0x23, 2, S, PredecodedOps::Store<uint32_t>)               \
+  X(ADDI, 0x13, 0, I, PredecodedOps::I<Add>)                      \
+  X(SLTI, 0x13, 2, I, PredecodedOps::I<Slt>)                      \
+  X(SLTIU, 0x13, 3, I, PredecodedOps::I<Sltu>)                    \
+  X(XORI, 0x13, 4, I, PredecodedOps::I<Xor>)                      \
+  X(ORI, 0x13, 6, I, PredecodedOps::I<Or>)                        \
+  X(ANDI, 0x13, 7, I, PredecodedOps::I<And>)                      \
+  X(SLLI, 0x13, 1, Shift, PredecodedOps::I<Sll>)                  \
+  X(SRLI, 0x13, 5, Shift, PredecodedOps::I<Srl>)                  \
+  X(SRAI, 0x13, 13, Shift, PredecodedOps::I<Sra>)                 \
+  X(ADD, 0x33, 0, R, PredecodedOps::R<Add>)                       \
+  X(SUB, 0x33, 8, R, PredecodedOps::R<Sub>)                       \
+  X(SLL, 0x33, 1, R, PredecodedOps::R<Sll>)                       \
+  X(SLT, 0x33, 2, R, PredecodedOps::R<Slt>)                       \
+  X(SLTU, 0x33, 3, R, PredecodedOps::R<Sltu>)                     \
+  X(XOR, 0x33, 4, R, PredecodedOps::R<Xor>)                       \
+  X(SRL, 0x33, 5, R, PredecodedOps::R<Srl>)                       \
+  X(SRA, 0x33, 13, R, PredecodedOps::R<Sra>)                      \
+  X(OR, 0x33, 6, R, PredecodedOps::R<Or>)                         \
+  X(AND, 0x33, 7, R, PredecodedOps::R<And>)
+// EXIT leaves a block that ends without a jump, HALT is li a0,255
+enum class Op : uint8_t {
+  EXIT,
+  HALT,
+#define RV32I_OP(name, opcode, key, format, handler) name,
+  RV32I_INSTRUCTIONS(RV32I_OP)
+#undef RV32I_OP
+};
+// an instruction decoded once: the operation and its operands, with the immediate already sign extended
+struct Predecoded {
+  uint32_t imm;
+  uint32_t raw;
+  uint8_t rd, rs1, rs2;
+  Op op;
+};
+Predecoded Predecode(uint32_t instr);
+// a basic block: straight-line instructions up to a branch or jump, see RV32IInterpreter::Translate
+struct Block {
+  // no exit has this PC, as instructions are aligned
+  static constexpr uint32_t kNoExit = 0xFFFFFFFF;
+  // the last instruction of a block that falls through to exits[0]
+  static constexpr Predecoded kExit{.imm = 0, .raw = 0, .rd = 0, .rs1 = 0, .rs2 = 0, .op = Op::EXIT};
+  uint32_t pc;
+  std::vector<Predecoded> ops;
+  // the static successors: taken and not taken for a branch, the target of jal, the next PC after EXIT
+  // each is looked up the first time it is taken, and then chained directly
+  struct Exit {
+    uint32_t pc = kNoExit;
+    Block *block = nullptr;
+    uint8_t *jump = nullptr;  // the rel32 of the native jump to the next block, see X86Jit::Chain
+  } exits[2];
+  // times entered by the interpreter, and the native code once it is hot, see X86Jit
+  uint32_t heat = 0;
+  void *native = nullptr;
+};
+class X86Jit;
 // no I type
 class RV32IInterpreter {
   std::vector<uint8_t> dat;
@@ -96,6 +186,30 @@ class RV32IInterpreter {
   uint32_t IR;
   uint32_t reg[32];
   size_t counter;
+  // translated blocks, with the block starting at each PC / 4
+  static constexpr size_t kMaxBlockLength = 64;
+  std::vector<std::unique_ptr<Block>> blocks;
+  std::vector<Block *> block_at;
+  std::vector<uint8_t> translated;  // words read by some block, 1 if so
+  bool code_dirty = false;          // a store hit a translated word, so all blocks are dropped
+  Block *Translate(uint32_t pc);
+  Block *Lookup(uint32_t pc);
+  void FlushBlocks();
+  // blocks entered this many times are compiled to native code, if the JIT is enabled
+  static constexpr uint32_t kHotBlock = 16;
+  std::unique_ptr<X86Jit> jit;
+  Block *jit_exit = nullptr;  // the native block that returned through a static exit
+  // the commit log if enabled, and its last record, whose rd is known only after it ran
+  std::unique_ptr<dark::commitlog::Writer> commit_log;
+  dark::commitlog::Record pending_commit;
+  bool has_pending_commit = false;
+  void Commit(uint32_t pc, uint32_t instruction);
+  void FinishCommit();
+  static void CommitHook(RV32IInterpreter *interpreter, uint32_t pc, uint32_t instruction) {
+    interpreter->Commit(pc, instruction);
+  }
+  friend struct PredecodedOps;
+  friend class X86Jit;
   friend void Execute_lui(RV32IInterpreter &interpreter, uint32_t instruction);
   friend void Execute_auipc(RV32IInterpreter &interpreter, uint32_t instruction);
   friend void Execute_jal(RV32IInterpreter &interpreter, uint32_t instruction);
@@ -142,9 +256,21 @@ class RV32IInterpreter {
   }
 
  public:
-  RV32IInterpreter() {
-    dat.reserve(1 << 20);
-    counter = 0;
+  RV32IInterpreter();
+  ~RV32IInterpreter();
+  // a store may overwrite code, then the blocks are translated again before the next one runs
+  void InvalidateCode(uint32_t addr, uint32_t len) {
+    for (uint32_t index = addr >> 2; index <= (addr + len - 1) >> 2 && index < translated.size(); index++) {
+      if (translated[index]) code_dirty = true;
+    }
+  }
+  // a load or a store of len bytes at addr, which throws if any of them is outside of memory
+  void CheckAccess(uint32_t addr, uint32_t len) {
+    if (addr < dat.size() && len <= dat.size() - addr) [[likely]]
+      return;
+    char message[80];
+    std::snprintf(message, sizeof(message), "Memory access out of range at PC=%08X: address %08X", PC, addr);
+    throw std::runtime_error(message);
   }
   void LoadProgram(std::istream &fin) {
     fin >> std::hex;
@@ -172,6 +298,7 @@ class RV32IInterpreter {
     } while (!fin.eof());
     PC = 0;
     memset(reg, 0, sizeof(reg));
+    FlushBlocks();
   }
   bool Fetch() {
     DEBUG_CERR << "Fetching PC: " << std::hex << PC << std::endl;
@@ -182,31 +309,848 @@ class RV32IInterpreter {
     }
     return true;
   }
-  void RunProgram() {
-    /**
-     * Begin simulation. The simulator will process RV32I instructions of U, J, B, I, S, R types (no I type).
-     * The simulator will stop when it encounters an li a0,255(addi a0, zero, 255) instruction, that is, when the
-     * simulator encounters it, it will do nothing and store the last 8 bits of a0 to exit_code.
-     * The simulator is little-endian.
-     */
-    while (Fetch()) {
-      // uint8_t opcode=IR&127;
-      // std::cout<<"PC: "<<std::hex<<PC<<std::endl;
-      std::cout << "csu is committing instruct " << std::hex << std::setw(8) << std::setfill('0') <<std::uppercase<< IR << std::endl;
-      PrintRegisters();
-      Decode(IR)(*this, IR);
-      DEBUG_CERR << std::endl;
-      DEBUG_CERR << "instruction to Fetch: " << std::hex << PC << std::endl << std::endl;
-    }
-    // now set exit_code
-    exit_code = reg[10] & 255;
-  }
+  // compile hot blocks to x86-64, false if this host cannot run them
+  bool EnableJit();
+  // record every instruction into a binary commit log, see include/commitlog.h
+  void SetCommitLog(const std::string &path) { commit_log = std::make_unique<dark::commitlog::Writer>(path); }
+  void RunProgram();
+  // one instruction at a time through Decode, the reference for the faster paths
+  void RunReference();
   uint8_t GetExitCode() { return exit_code; }
 };
-int main() {
+// the handlers of predecoded instructions, one template per instruction format
+struct PredecodedOps {
+  template <uint32_t (*Op)(uint32_t, uint32_t)>
+  static void R(RV32IInterpreter &interpreter, const Predecoded &ins) {
+    interpreter.reg[ins.rd] = Op(interpreter.reg[ins.rs1], interpreter.reg[ins.rs2]);
+    interpreter.reg[0] = 0;
+    interpreter.PC += 4;
+  }
+  template <uint32_t (*Op)(uint32_t, uint32_t)>
+  static void I(RV32IInterpreter &interpreter, const Predecoded &ins) {
+    interpreter.reg[ins.rd] = Op(interpreter.reg[ins.rs1], ins.imm);
+    interpreter.reg[0] = 0;
+    interpreter.PC += 4;
+  }
+  template <typename T, bool Signed>
+  static void Load(RV32IInterpreter &interpreter, const Predecoded &ins) {
+    uint32_t addr = interpreter.reg[ins.rs1] + ins.imm;
+    interpreter.CheckAccess(addr, sizeof(T));
+    T val;
+    memcpy(&val, &interpreter.dat[addr], sizeof(T));
+    if constexpr (Signed) {
+      interpreter.reg[ins.rd] = static_cast<uint32_t>(static_cast<int32_t>(static_cast<std::make_signed_t<T>>(val)));
+    } else {
+      interpreter.reg[ins.rd] = val;
+    }
+    interpreter.reg[0] = 0;
+    interpreter.PC += 4;
+  }
+  template <typename T>
+  static void Store(RV32IInterpreter &interpreter, const Predecoded &ins) {
+    uint32_t addr = interpreter.reg[ins.rs1] + ins.imm;
+    interpreter.CheckAccess(addr, sizeof(T));
+    T val = static_cast<T>(interpreter.reg[ins.rs2]);
+    memcpy(&interpreter.dat[addr], &val, sizeof(T));
+    interpreter.InvalidateCode(addr, sizeof(T));
+    interpreter.PC += 4;
+  }
+  template <bool (*Cond)(uint32_t, uint32_t)>
+  static void B(RV32IInterpreter &interpreter, const Predecoded &ins) {
+    interpreter.PC += Cond(interpreter.reg[ins.rs1], interpreter.reg[ins.rs2]) ? ins.imm : 4;
+  }
+  static void Lui(RV32IInterpreter &interpreter, const Predecoded &ins) {
+    interpreter.reg[ins.rd] = ins.imm;
+    interpreter.reg[0] = 0;
+    interpreter.PC += 4;
+  }
+  static void Auipc(RV32IInterpreter &interpreter, const Predecoded &ins) {
+    interpreter.reg[ins.rd] = interpreter.PC + ins.imm;
+    interpreter.reg[0] = 0;
+    interpreter.PC += 4;
+  }
+  static void Jal(RV32IInterpreter &interpreter, const Predecoded &ins) {
+    interpreter.reg[ins.rd] = interpreter.PC + 4;
+    interpreter.reg[0] = 0;
+    interpreter.PC += ins.imm;
+  }
+  static void Jalr(RV32IInterpreter &interpreter, const Predecoded &ins) {
+    uint32_t t = interpreter.PC + 4;
+    interpreter.PC = (interpreter.reg[ins.rs1] + ins.imm) & 0xFFFFFFFE;
+    interpreter.reg[ins.rd] = t;
+    interpreter.reg[0] = 0;
+  }
+};
+inline uint32_t Add(uint32_t a, uint32_t b) { return a + b; }
+inline uint32_t Sub(uint32_t a, uint32_t b) { return a - b; }
+inline uint32_t Sll(uint32_t a, uint32_t b) { return a << (b & 31); }
+inline uint32_t Slt(uint32_t a, uint32_t b) { return static_cast<int32_t>(a) < static_cast<int32_t>(b); }
+inline uint32_t Sltu(uint32_t a, uint32_t b) { return a < b; }
+inline uint32_t Xor(uint32_t a, uint32_t b) { return a ^ b; }
+inline uint32_t Srl(uint32_t a, uint32_t b) { return a >> (b & 31); }
+inline uint32_t Sra(uint32_t a, uint32_t b) { return static_cast<uint32_t>(static_cast<int32_t>(a) >> (b & 31)); }
+inline uint32_t Or(uint32_t a, uint32_t b) { return a | b; }
+inline uint32_t And(uint32_t a, uint32_t b) { return a & b; }
+inline bool Eq(uint32_t a, uint32_t b) { return a == b; }
+inline bool Ne(uint32_t a, uint32_t b) { return a != b; }
+inline bool Lt(uint32_t a, uint32_t b) { return static_cast<int32_t>(a) < static_cast<int32_t>(b); }
+inline bool Ge(uint32_t a, uint32_t b) { return static_cast<int32_t>(a) >= static_cast<int32_t>(b); }
+inline bool Ltu(uint32_t a, uint32_t b) { return a < b; }
+inline bool Geu(uint32_t a, uint32_t b) { return a >= b; }
+// the immediates of each format, sign extended
+inline uint32_t ImmI(uint32_t instr) { return static_cast<uint32_t>(static_cast<int32_t>(instr) >> 20); }
+inline uint32_t ImmS(uint32_t instr) {
+  return static_cast<uint32_t>(static_cast<int32_t>(instr & 0xFE000000) >> 20) | ((instr >> 7) & 31);
+}
+inline uint32_t ImmB(uint32_t instr) {
+  return static_cast<uint32_t>(static_cast<int32_t>(instr & 0x80000000) >> 19) | ((instr & 0x80) << 4) |
+         ((instr >> 20) & 0x7E0) | ((instr >> 7) & 0x1E);
+}
+inline uint32_t ImmJ(uint32_t instr) {
+  return static_cast<uint32_t>(static_cast<int32_t>(instr & 0x80000000) >> 11) | (instr & 0xFF000) |
+         ((instr >> 9) & 0x800) | ((instr >> 20) & 0x7FE);
+}
+// the same keys as ExecuteFuncMap, with the format of the immediate
+enum class Format { R, I, Shift, S, B, U, J };
+std::map<std::pair<uint8_t, uint8_t>, std::pair<Op, Format>> PredecodeMap = {
+#define RV32I_KEY(name, opcode, key, format, handler) {{opcode, key}, {Op::name, Format::format}},
+    RV32I_INSTRUCTIONS(RV32I_KEY)
+#undef RV32I_KEY
+};
+Predecoded Predecode(uint32_t instr) {
+  Predecoded ins{};
+  ins.raw = instr;
+  if (instr == 0x0FF00513) {
+    ins.op = Op::HALT;
+    return ins;
+  }
+  auto it = PredecodeMap.find(DecodeKey(instr));
+  if (it == PredecodeMap.end()) {
+    throw std::runtime_error("Unsupported instruction");
+  }
+  ins.op = it->second.first;
+  ins.rd = (instr >> 7) & 31;
+  ins.rs1 = (instr >> 15) & 31;
+  ins.rs2 = (instr >> 20) & 31;
+  switch (it->second.second) {
+    case Format::R:
+      break;
+    case Format::I:
+      ins.imm = ImmI(instr);
+      break;
+    case Format::Shift:
+      ins.imm = (instr >> 20) & 31;
+      break;
+    case Format::S:
+      ins.imm = ImmS(instr);
+      break;
+    case Format::B:
+      ins.imm = ImmB(instr);
+      break;
+    case Format::U:
+      ins.imm = instr & 0xFFFFF000;
+      break;
+    case Format::J:
+      ins.imm = ImmJ(instr);
+      break;
+  }
+  return ins;
+}
+// block ends at a branch or a jump, whose exits are known only after it ran
+constexpr bool IsJump(Op op) { return op == Op::JAL || op == Op::JALR || (op >= Op::BEQ && op <= Op::BGEU); }
+constexpr bool IsStore(Op op) { return op >= Op::SB && op <= Op::SW; }
+#ifdef RV32I_JIT
+// writes x86-64 machine code, only the few encodings X86Jit needs
+struct X86Emitter {
+  uint8_t *p;
+  void Bytes(std::initializer_list<uint8_t> bytes) {
+    for (uint8_t byte : bytes) *p++ = byte;
+  }
+  void U32(uint32_t value) {
+    memcpy(p, &value, 4);
+    p += 4;
+  }
+  void U64(uint64_t value) {
+    memcpy(p, &value, 8);
+    p += 8;
+  }
+  // point the rel32 at site to target
+  static void Patch(uint8_t *site, const void *target) {
+    int32_t rel = static_cast<int32_t>(static_cast<const uint8_t *>(target) - (site + 4));
+    memcpy(site, &rel, 4);
+  }
+  // a rel32 to be patched later when target is nullptr, returns its site
+  uint8_t *Rel32(const void *target) {
+    uint8_t *site = p;
+    p += 4;
+    if (target != nullptr) Patch(site, target);
+    return site;
+  }
+  uint8_t *Jmp(const void *target) {
+    Bytes({0xE9});
+    return Rel32(target);
+  }
+  uint8_t *Jcc(uint8_t cc, const void *target) {
+    Bytes({0x0F, cc});
+    return Rel32(target);
+  }
+  // eax (host 0) or ecx (host 1) = guest register x, which lives at [rbx + 4 * x]
+  void LoadReg(uint8_t host, uint8_t x) {
+    Bytes({0x8B, static_cast<uint8_t>(0x83 | host << 3)});
+    U32(4 * x);
+  }
+  // eax = eax op guest register x, for the opcodes of the form op r32, r/m32
+  void OpReg(uint8_t opcode, uint8_t x) {
+    Bytes({opcode, 0x83});
+    U32(4 * x);
+  }
+  // eax = eax op imm32, for the opcodes of the form op eax, imm32
+  void OpImm(uint8_t opcode, uint32_t imm) {
+    Bytes({opcode});
+    U32(imm);
+  }
+  void StoreEax(uint8_t x) {
+    if (x == 0) return;
+    Bytes({0x89, 0x83});
+    U32(4 * x);
+  }
+  // dword [rbx + disp] = imm
+  void StoreImm(int32_t disp, uint32_t imm) {
+    Bytes({0xC7, 0x83});
+    U32(disp);
+    U32(imm);
+  }
+  void MovEax(uint32_t imm) { OpImm(0xB8, imm); }
+  // eax = condition cc of the last cmp, 0 or 1
+  void SetEax(uint8_t cc) { Bytes({0x0F, cc, 0xC0, 0x0F, 0xB6, 0xC0}); }
+  // ecx = eax + offset >> 2, then compare the byte of it in the table at r13 with 0
+  void TestWord(uint8_t offset) {
+    if (offset == 0) {
+      Bytes({0x89, 0xC1});
+    } else {
+      Bytes({0x8D, 0x48, offset});
+    }
+    Bytes({0xC1, 0xE9, 0x02, 0x41, 0x80, 0x7C, 0x0D, 0x00, 0x00});
+  }
+};
+/**
+ * Compiles hot blocks to x86-64 in an executable code cache.
+ * The guest registers stay in RV32IInterpreter::reg, pinned in rbx; memory is at r12, the translated word map
+ * at r13, and the native entry of each PC / 4 at r15. Each instruction loads its operands into eax and ecx
+ * and stores the result back, so native code and the handlers can take turns at any block boundary.
+ * A load or a store outside of memory leaves native code before it, and the handler of the instruction throws.
+ * A store to a translated word leaves native code after it, like code_dirty in the interpreter.
+ * A static exit first returns to the interpreter, which chains it to the native code of the next block once
+ * that is compiled; jalr looks its target up in the entry table directly.
+ * The code cache is never writable and executable at once: it is made writable to compile or chain,
+ * and executable again before native code runs.
+ */
+class X86Jit {
+ public:
+  // why native code returned: a static exit of RV32IInterpreter::jit_exit, or PC needs the interpreter
+  enum Reason : uint32_t { kTaken = 0, kNotTaken = 1, kIndirect, kFallback, kCodeDirty };
+
+ private:
+  static constexpr size_t kCacheSize = 32 << 20;
+  // more than the code of any block, about 96 bytes for each of kMaxBlockLength instructions
+  static constexpr size_t kMaxBlockCode = 16 << 10;
+  typedef Reason (*Trampoline)(uint32_t *reg, uint8_t *mem, const uint8_t *translated, void *const *entry_at,
+                               void *code);
+
+  RV32IInterpreter &interpreter;
+  uint8_t *cache;
+  bool writable = true;
+  uint8_t *code_begin, *code_cur;
+  Trampoline trampoline;
+  uint8_t *epilogue;
+  std::vector<void *> entry_at;
+  // the offsets of PC and jit_exit from reg
+  int32_t pc_disp, exit_disp;
+
+  template <typename T>
+  int32_t Disp(T &member) {
+    return static_cast<int32_t>(reinterpret_cast<char *>(&member) - reinterpret_cast<char *>(interpreter.reg));
+  }
+  // false if the protection cannot be changed
+  bool Protect(bool write) {
+    if (writable == write) return true;
+    if (mprotect(cache, kCacheSize, write ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC) != 0) return false;
+    writable = write;
+    return true;
+  }
+  void Writable() {
+    if (!Protect(true)) throw std::runtime_error("JIT: cannot make the code cache writable");
+  }
+  void EmitExit(X86Emitter &e, Block::Exit &exit) {
+    e.StoreImm(pc_disp, exit.pc);
+    exit.jump = e.Jmp(nullptr);
+  }
+
+ public:
+  explicit X86Jit(RV32IInterpreter &interpreter)
+      : interpreter(interpreter), pc_disp(Disp(interpreter.PC)), exit_disp(Disp(interpreter.jit_exit)) {
+    void *map = mmap(nullptr, kCacheSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    cache = map == MAP_FAILED ? nullptr : static_cast<uint8_t *>(map);
+    if (cache == nullptr) return;
+    X86Emitter e{cache};
+    // push rbx, r12, r13, r14, r15, which also aligns the stack for calls; pin the arguments and jump to code
+    trampoline = reinterpret_cast<Trampoline>(e.p);
+    e.Bytes({0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57});
+    e.Bytes({0x48, 0x89, 0xFB, 0x49, 0x89, 0xF4, 0x49, 0x89, 0xD5, 0x49, 0x89, 0xCF, 0x41, 0xFF, 0xE0});
+    epilogue = e.p;
+    e.Bytes({0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3});
+    code_begin = code_cur = e.p;
+    // a host that never allows executable pages is left to the interpreter
+    if (!Protect(false)) {
+      munmap(cache, kCacheSize);
+      cache = nullptr;
+    }
+  }
+  ~X86Jit() {
+    if (cache != nullptr) munmap(cache, kCacheSize);
+  }
+  X86Jit(const X86Jit &) = delete;
+  X86Jit &operator=(const X86Jit &) = delete;
+
+  bool Ready() const { return cache != nullptr; }
+  // drop all native code, with the blocks of the interpreter
+  void Reset() {
+    code_cur = code_begin;
+    entry_at.assign(interpreter.dat.size() / 4, nullptr);
+  }
+  Reason Run(void *code) {
+    if (!Protect(false)) throw std::runtime_error("JIT: cannot make the code cache executable");
+    return trampoline(interpreter.reg, interpreter.dat.data(), interpreter.translated.data(), entry_at.data(), code);
+  }
+  // the native exit now jumps straight to the native code of its block
+  void Chain(Block::Exit &exit) {
+    if (exit.jump == nullptr || exit.block->native == nullptr) return;
+    Writable();
+    X86Emitter::Patch(exit.jump, exit.block->native);
+  }
+  // false if the code cache is full
+  bool Compile(Block *block);
+};
+bool X86Jit::Compile(Block *block) {
+  // a halt is always left to the interpreter
+  if (block->ops[0].op == Op::HALT) return true;
+  if (static_cast<size_t>(cache + kCacheSize - code_cur) < kMaxBlockCode) return false;
+  Writable();
+  X86Emitter e{code_cur};
+  // the exits out of line, after the block: the site of each jump there, why it leaves and PC if to be set
+  struct Leave {
+    uint8_t *site;
+    Reason reason;
+    uint32_t pc;
+  };
+  std::vector<Leave> leaves;
+  const uint32_t memory_size = static_cast<uint32_t>(interpreter.dat.size());
+  uint32_t pc = block->pc;
+  for (const Predecoded &ins : block->ops) {
+    if (interpreter.commit_log != nullptr && ins.op != Op::EXIT) {
+      // CommitHook(&interpreter, pc, ins.raw)
+      e.Bytes({0x48, 0xBF});
+      e.U64(reinterpret_cast<uint64_t>(&interpreter));
+      e.Bytes({0xBE});
+      e.U32(pc);
+      e.Bytes({0xBA});
+      e.U32(ins.raw);
+      e.Bytes({0x48, 0xB8});
+      e.U64(reinterpret_cast<uint64_t>(&RV32IInterpreter::CommitHook));
+      e.Bytes({0xFF, 0xD0});
+    }
+    // eax = the address of a load or a store, leaving to the handler if sizeof(T) bytes there are out of memory
+    auto address = [&](uint32_t size) {
+      e.LoadReg(0, ins.rs1);
+      e.OpImm(0x05, ins.imm);
+      e.OpImm(0x3D, memory_size - size);
+      leaves.push_back({e.Jcc(0x87, nullptr), kFallback, pc});
+    };
+    auto load = [&](uint32_t size, std::initializer_list<uint8_t> mov) {
+      address(size);
+      e.Bytes(mov);
+      e.StoreEax(ins.rd);
+    };
+    auto store = [&](uint32_t size, std::initializer_list<uint8_t> mov) {
+      address(size);
+      e.LoadReg(1, ins.rs2);
+      e.Bytes(mov);
+      e.TestWord(0);
+      leaves.push_back({e.Jcc(0x85, nullptr), kCodeDirty, pc + 4});
+      if (size > 1) {
+        e.TestWord(static_cast<uint8_t>(size - 1));
+        leaves.push_back({e.Jcc(0x85, nullptr), kCodeDirty, pc + 4});
+      }
+    };
+    auto branch = [&](uint8_t cc) {
+      e.LoadReg(0, ins.rs1);
+      e.OpReg(0x3B, ins.rs2);
+      uint8_t *taken = e.Jcc(cc, nullptr);
+      EmitExit(e, block->exits[1]);
+      X86Emitter::Patch(taken, e.p);
+      EmitExit(e, block->exits[0]);
+    };
+    // the ALU, with nothing to do for x0
+    auto alu_reg = [&](uint8_t opcode) {
+      if (ins.rd == 0) return;
+      e.LoadReg(0, ins.rs1);
+      e.OpReg(opcode, ins.rs2);
+      e.StoreEax(ins.rd);
+    };
+    auto alu_imm = [&](uint8_t opcode) {
+      if (ins.rd == 0) return;
+      e.LoadReg(0, ins.rs1);
+      e.OpImm(opcode, ins.imm);
+      e.StoreEax(ins.rd);
+    };
+    auto set_reg = [&](uint8_t cc) {
+      if (ins.rd == 0) return;
+      e.LoadReg(0, ins.rs1);
+      e.OpReg(0x3B, ins.rs2);
+      e.SetEax(cc);
+      e.StoreEax(ins.rd);
+    };
+    auto set_imm = [&](uint8_t cc) {
+      if (ins.rd == 0) return;
+      e.LoadReg(0, ins.rs1);
+      e.OpImm(0x3D, ins.imm);
+      e.SetEax(cc);
+      e.StoreEax(ins.rd);
+    };
+    // modrm is E0 for shl, E8 for shr, F8 for sar
+    auto shift_reg = [&](uint8_t modrm) {
+      if (ins.rd == 0) return;
+      e.LoadReg(0, ins.rs1);
+      e.LoadReg(1, ins.rs2);
+      e.Bytes({0xD3, modrm});
+      e.StoreEax(ins.rd);
+    };
+    auto shift_imm = [&](uint8_t modrm) {
+      if (ins.rd == 0) return;
+      e.LoadReg(0, ins.rs1);
+      e.Bytes({0xC1, modrm, static_cast<uint8_t>(ins.imm)});
+      e.StoreEax(ins.rd);
+    };
+    switch (ins.op) {
+      case Op::EXIT:
+        EmitExit(e, block->exits[0]);
+        break;
+      case Op::HALT:
+        break;
+      case Op::LUI:
+        if (ins.rd != 0) e.StoreImm(4 * ins.rd, ins.imm);
+        break;
+      case Op::AUIPC:
+        if (ins.rd != 0) e.StoreImm(4 * ins.rd, pc + ins.imm);
+        break;
+      case Op::JAL:
+        if (ins.rd != 0) e.StoreImm(4 * ins.rd, pc + 4);
+        EmitExit(e, block->exits[0]);
+        break;
+      case Op::JALR:
+        // PC = eax = rs1 + imm & ~1, then jump to its native code if there is some
+        e.LoadReg(0, ins.rs1);
+        e.OpImm(0x05, ins.imm);
+        e.OpImm(0x25, 0xFFFFFFFE);
+        if (ins.rd != 0) e.StoreImm(4 * ins.rd, pc + 4);
+        e.Bytes({0x89, 0x83});
+        e.U32(pc_disp);
+        // test al, 3; mov ecx, eax; shr ecx, 2; cmp ecx, entries
+        e.Bytes({0xA8, 0x03});
+        leaves.push_back({e.Jcc(0x85, nullptr), kIndirect, 0});
+        e.Bytes({0x89, 0xC1, 0xC1, 0xE9, 0x02, 0x81, 0xF9});
+        e.U32(static_cast<uint32_t>(entry_at.size()));
+        leaves.push_back({e.Jcc(0x83, nullptr), kIndirect, 0});
+        // mov rdx, [r15 + rcx * 8]; test rdx, rdx; jz; jmp rdx
+        e.Bytes({0x49, 0x8B, 0x14, 0xCF, 0x48, 0x85, 0xD2});
+        leaves.push_back({e.Jcc(0x84, nullptr), kIndirect, 0});
+        e.Bytes({0xFF, 0xE2});
+        break;
+      case Op::BEQ:
+        branch(0x84);
+        break;
+      case Op::BNE:
+        branch(0x85);
+        break;
+      case Op::BLT:
+        branch(0x8C);
+        break;
+      case Op::BGE:
+        branch(0x8D);
+        break;
+      case Op::BLTU:
+        branch(0x82);
+        break;
+      case Op::BGEU:
+        branch(0x83);
+        break;
+      // movsx, movzx or mov eax, [r12 + rax]
+      case Op::LB:
+        load(1, {0x41, 0x0F, 0xBE, 0x04, 0x04});
+        break;
+      case Op::LH:
+        load(2, {0x41, 0x0F, 0xBF, 0x04, 0x04});
+        break;
+      case Op::LW:
+        load(4, {0x41, 0x8B, 0x04, 0x04});
+        break;
+      case Op::LBU:
+        load(1, {0x41, 0x0F, 0xB6, 0x04, 0x04});
+        break;
+      case Op::LHU:
+        load(2, {0x41, 0x0F, 0xB7, 0x04, 0x04});
+        break;
+      // mov [r12 + rax], cl, cx or ecx
+      case Op::SB:
+        store(1, {0x41, 0x88, 0x0C, 0x04});
+        break;
+      case Op::SH:
+        store(2, {0x66, 0x41, 0x89, 0x0C, 0x04});
+        break;
+      case Op::SW:
+        store(4, {0x41, 0x89, 0x0C, 0x04});
+        break;
+      case Op::ADDI:
+        alu_imm(0x05);
+        break;
+      case Op::SLTI:
+        set_imm(0x9C);
+        break;
+      case Op::SLTIU:
+        set_imm(0x92);
+        break;
+      case Op::XORI:
+        alu_imm(0x35);
+        break;
+      case Op::ORI:
+        alu_imm(0x0D);
+        break;
+      case Op::ANDI:
+        alu_imm(0x25);
+        break;
+      case Op::SLLI:
+        shift_imm(0xE0);
+        break;
+      case Op::SRLI:
+        shift_imm(0xE8);
+        break;
+      case Op::SRAI:
+        shift_imm(0xF8);
+        break;
+      case Op::ADD:
+        alu_reg(0x03);
+        break;
+      case Op::SUB:
+        alu_reg(0x2B);
+        break;
+      case Op::SLL:
+        shift_reg(0xE0);
+        break;
+      case Op::SLT:
+        set_reg(0x9C);
+        break;
+      case Op::SLTU:
+        set_reg(0x92);
+        break;
+      case Op::XOR:
+        alu_reg(0x33);
+        break;
+      case Op::SRL:
+        shift_reg(0xE8);
+        break;
+      case Op::SRA:
+        shift_reg(0xF8);
+        break;
+      case Op::OR:
+        alu_reg(0x0B);
+        break;
+      case Op::AND:
+        alu_reg(0x23);
+        break;
+    }
+    pc += 4;
+  }
+  for (const Leave &leave : leaves) {
+    X86Emitter::Patch(leave.site, e.p);
+    if (leave.reason != kIndirect) e.StoreImm(pc_disp, leave.pc);
+    e.MovEax(leave.reason);
+    e.Jmp(epilogue);
+  }
+  // an exit not chained yet sets jit_exit, mov rax, block; mov [rbx + exit_disp], rax
+  for (uint32_t i = 0; i < 2; i++) {
+    if (block->exits[i].jump == nullptr) continue;
+    X86Emitter::Patch(block->exits[i].jump, e.p);
+    e.Bytes({0x48, 0xB8});
+    e.U64(reinterpret_cast<uint64_t>(block));
+    e.Bytes({0x48, 0x89, 0x83});
+    e.U32(exit_disp);
+    e.MovEax(i);
+    e.Jmp(epilogue);
+  }
+  block->native = code_cur;
+  entry_at[block->pc >> 2] = code_cur;
+  code_cur = e.p;
+  return true;
+}
+#else
+class X86Jit {};
+#endif
+RV32IInterpreter::RV32IInterpreter() {
+  dat.resize(1 << 20);
+  counter = 0;
+}
+RV32IInterpreter::~RV32IInterpreter() = default;
+bool RV32IInterpreter::EnableJit() {
+#ifdef RV32I_JIT
+  auto compiler = std::make_unique<X86Jit>(*this);
+  if (!compiler->Ready()) return false;
+  jit = std::move(compiler);
+  jit->Reset();
+  return true;
+#else
+  return false;
+#endif
+}
+// record the instruction at pc before it runs, with the address and the data of a load or a store
+void RV32IInterpreter::Commit(uint32_t pc, uint32_t instruction) {
+  FinishCommit();
+  dark::commitlog::Record &record = pending_commit;
+  record = {};
+  record.pc = pc;
+  record.instruction = instruction;
+  uint8_t opcode = instruction & 127;
+  uint8_t rd = (instruction >> 7) & 31;
+  if (opcode == 0x03 || opcode == 0x23) {
+    // funct3 is 0, 1, 2 for bytes, halves and words, plus 4 for unsigned loads
+    uint32_t size = 1u << ((instruction >> 12) & 3);
+    record.flags |= dark::commitlog::kMemory;
+    record.addr = reg[(instruction >> 15) & 31] + (opcode == 0x03 ? ImmI(instruction) : ImmS(instruction));
+    if (opcode == 0x23) {
+      record.data = reg[(instruction >> 20) & 31] & (size == 4 ? 0xFFFFFFFF : (1u << (size * 8)) - 1);
+    } else if (record.addr < dat.size() && size <= dat.size() - record.addr) {
+      memcpy(&record.data, &dat[record.addr], size);
+    }
+  }
+  if (opcode != 0x63 && opcode != 0x23 && rd != 0) {
+    record.flags |= dark::commitlog::kWritesRd;
+    record.rd = rd;
+  }
+  has_pending_commit = true;
+}
+void RV32IInterpreter::FinishCommit() {
+  if (!has_pending_commit) return;
+  if (pending_commit.flags & dark::commitlog::kWritesRd) pending_commit.value = reg[pending_commit.rd];
+  commit_log->write(pending_commit);
+  has_pending_commit = false;
+}
+void RV32IInterpreter::FlushBlocks() {
+  blocks.clear();
+  block_at.assign(dat.size() / 4, nullptr);
+  translated.assign(dat.size() / 4, 0);
+  code_dirty = false;
+#ifdef RV32I_JIT
+  if (jit) jit->Reset();
+#endif
+}
+// decode the instructions from pc up to the first branch or jump, a halt, or kMaxBlockLength of them
+Block *RV32IInterpreter::Translate(uint32_t pc) {
+  auto block = std::make_unique<Block>();
+  block->pc = pc;
+  for (uint32_t cur = pc;; cur += 4) {
+    if ((cur >> 2) >= block_at.size() || block->ops.size() == kMaxBlockLength) {
+      block->ops.push_back(Block::kExit);
+      block->exits[0].pc = cur;
+      break;
+    }
+    uint32_t instr = *reinterpret_cast<uint32_t *>(&dat[cur]);
+    bool halt = instr == 0x0FF00513;
+    // an unsupported instruction throws when it is reached, as it ends the block before it
+    bool supported = halt || PredecodeMap.count(DecodeKey(instr)) != 0;
+    if (!block->ops.empty() && (halt || !supported)) {
+      block->ops.push_back(Block::kExit);
+      block->exits[0].pc = cur;
+      break;
+    }
+    Predecoded ins = Predecode(instr);
+    block->ops.push_back(ins);
+    translated[cur >> 2] = 1;
+    if (ins.op == Op::HALT) break;
+    if (ins.op == Op::JAL) {
+      block->exits[0].pc = cur + ins.imm;
+      break;
+    }
+    if (IsJump(ins.op)) {
+      if (ins.op != Op::JALR) {
+        block->exits[0].pc = cur + ins.imm;
+        block->exits[1].pc = cur + 4;
+      }
+      break;
+    }
+  }
+  block_at[pc >> 2] = block.get();
+  blocks.push_back(std::move(block));
+  return blocks.back().get();
+}
+// the block starting at pc, translated if needed, or nullptr if pc cannot start one
+Block *RV32IInterpreter::Lookup(uint32_t pc) {
+  if (code_dirty) FlushBlocks();
+  if ((pc & 3) != 0 || (pc >> 2) >= block_at.size()) return nullptr;
+  Block *block = block_at[pc >> 2];
+  return block != nullptr ? block : Translate(pc);
+}
+void RV32IInterpreter::RunProgram() {
+  /**
+   * Begin simulation. The simulator will process RV32I instructions of U, J, B, I, S, R types (no I type).
+   * The simulator will stop when it encounters an li a0,255(addi a0, zero, 255) instruction, that is, when the
+   * simulator encounters it, it will do nothing and store the last 8 bits of a0 to exit_code.
+   * The simulator is little-endian.
+   * Instructions run block by block through threaded code: each handler jumps straight to the next one,
+   * and the end of a block jumps to the next block through its chained exits.
+   * An instruction that cannot start a block, at a misaligned PC or outside of memory, takes the slow path.
+   * With the JIT, a block entered kHotBlock times runs as native code from then on.
+   */
+  Block *block;
+  Block::Exit *exit;
+  Predecoded *ins;
+#ifdef RV32I_JIT
+  X86Jit::Reason reason;
+#endif
+#if defined(__GNUC__)
+  // computed goto, one indirect jump per handler
+  static void *const labels[] = {
+      &&op_EXIT,
+      &&op_HALT,
+#define RV32I_LABEL(name, opcode, key, format, handler) &&op_##name,
+      RV32I_INSTRUCTIONS(RV32I_LABEL)
+#undef RV32I_LABEL
+  };
+#define RV32I_DISPATCH goto *labels[static_cast<uint8_t>(ins->op)]
+#define RV32I_CASE(name) op_##name
+#else
+  // a switch for compilers without computed goto
+#define RV32I_DISPATCH continue
+#define RV32I_CASE(name) case Op::name
+#endif
+lookup:
+  block = Lookup(PC);
+  if (block == nullptr) goto slow_path;
+enter:
+#ifdef RV32I_JIT
+  if (jit != nullptr) {
+    if (block->native == nullptr && ++block->heat == kHotBlock && !jit->Compile(block)) {
+      // the code cache is full, so start over with no blocks
+      FlushBlocks();
+      goto lookup;
+    }
+    if (block->native != nullptr) goto native;
+  }
+#endif
+  ins = block->ops.data();
+#if defined(__GNUC__)
+  RV32I_DISPATCH;
+#else
+  for (;;) switch (ins->op) {
+#endif
+  RV32I_CASE(EXIT):
+    goto chain;
+  RV32I_CASE(HALT):
+    goto halt;
+#define RV32I_HANDLER(name, opcode, key, format, handler) \
+  RV32I_CASE(name):                                       \
+    if (commit_log != nullptr) Commit(PC, ins->raw);      \
+    handler(*this, *ins);                                 \
+    if constexpr (IsJump(Op::name)) goto chain;           \
+    if constexpr (IsStore(Op::name))                      \
+      if (code_dirty) goto lookup;                        \
+    ++ins;                                                \
+    RV32I_DISPATCH;
+    RV32I_INSTRUCTIONS(RV32I_HANDLER)
+#undef RV32I_HANDLER
+#if !defined(__GNUC__)
+  }
+#endif
+chain:
+  // follow the exit PC took, looking its block up only the first time
+  exit = PC == block->exits[0].pc ? &block->exits[0] : PC == block->exits[1].pc ? &block->exits[1] : nullptr;
+  if (exit == nullptr) goto lookup;
+  if (exit->block == nullptr) {
+    exit->block = Lookup(PC);
+    if (exit->block == nullptr) goto slow_path;
+  }
+  block = exit->block;
+  goto enter;
+#ifdef RV32I_JIT
+native:
+  reason = jit->Run(block->native);
+  if (reason == X86Jit::kIndirect || reason == X86Jit::kCodeDirty) goto lookup;
+  if (reason == X86Jit::kFallback) {
+    // the native code has recorded the instruction already, and its handler throws as the access is out of memory
+    Fetch();
+    PrintRegisters();
+    Decode(IR)(*this, IR);
+    goto lookup;
+  }
+  exit = &jit_exit->exits[reason];
+  if (exit->block == nullptr) {
+    exit->block = Lookup(PC);
+    if (exit->block == nullptr) goto slow_path;
+  }
+  block = exit->block;
+  if (block->native != nullptr) jit->Chain(*exit);
+  goto enter;
+#endif
+slow_path:
+  if (!Fetch()) goto halt;
+  if (commit_log != nullptr) Commit(PC, IR);
+  PrintRegisters();
+  Decode(IR)(*this, IR);
+  goto lookup;
+halt:
+#undef RV32I_CASE
+#undef RV32I_DISPATCH
+  if (commit_log != nullptr) FinishCommit();
+  // now set exit_code
+  exit_code = reg[10] & 255;
+}
+void RV32IInterpreter::RunReference() {
+  while (Fetch()) {
+    if (commit_log != nullptr) Commit(PC, IR);
+    PrintRegisters();
+    Decode(IR)(*this, IR);
+  }
+  if (commit_log != nullptr) FinishCommit();
+  exit_code = reg[10] & 255;
+}
+int main(int argc, char **argv) {
+  bool jit = false, reference = false;
+  std::string commit_log;
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg.starts_with("--commit-log=")) {
+      commit_log = arg.substr(13);
+    } else if (arg == "--jit") {
+      jit = true;
+    } else if (arg == "--reference") {
+      reference = true;
+    } else {
+      std::cerr << "Usage: " << argv[0] << " [--jit | --reference] [--commit-log=<file>] < program" << std::endl;
+      return 1;
+    }
+  }
   RV32IInterpreter interpreter;
   interpreter.LoadProgram(std::cin);
-  interpreter.RunProgram();
+  if (!commit_log.empty()) interpreter.SetCommitLog(commit_log);
+  if (jit && !interpreter.EnableJit()) std::cerr << "the JIT is not available, interpreting" << std::endl;
+  try {
+    if (reference) {
+      interpreter.RunReference();
+    } else {
+      interpreter.RunProgram();
+    }
+  } catch (const std::runtime_error &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
   std::cout << std::dec << (int)interpreter.GetExitCode() << std::endl;
   return 0;
 }
@@ -520,6 +1464,7 @@ void Execute_lb(RV32IInterpreter &interpreter, uint32_t instruction) {
   }
   int32_t offset_signed = *reinterpret_cast<int32_t *>(&offset);
   uint32_t addr = interpreter.reg[rs1] + offset_signed;
+  interpreter.CheckAccess(addr, 1);
   uint32_t val = interpreter.dat[addr];
   if (ReadBit(val, 7)) {
     for (int i = 8; i < 32; ++i) {
@@ -547,6 +1492,7 @@ void Execute_lh(RV32IInterpreter &interpreter, uint32_t instruction) {
   }
   int32_t offset_signed = *reinterpret_cast<int32_t *>(&offset);
   uint32_t addr = interpreter.reg[rs1] + offset_signed;
+  interpreter.CheckAccess(addr, 2);
   uint32_t val = *(reinterpret_cast<uint16_t *>(&interpreter.dat[addr]));
   if (ReadBit(val, 15)) {
     for (int i = 16; i < 32; ++i) {
@@ -574,6 +1520,7 @@ void Execute_lw(RV32IInterpreter &interpreter, uint32_t instruction) {
   }
   int32_t offset_signed = *reinterpret_cast<int32_t *>(&offset);
   uint32_t addr = interpreter.reg[rs1] + offset_signed;
+  interpreter.CheckAccess(addr, 4);
   uint32_t val = *(reinterpret_cast<uint32_t *>(&interpreter.dat[addr]));
   interpreter.reg[rd] = val;
   interpreter.reg[0] = 0;
@@ -596,6 +1543,7 @@ void Execute_lbu(RV32IInterpreter &interpreter, uint32_t instruction) {
   }
   int32_t offset_signed = *reinterpret_cast<int32_t *>(&offset);
   uint32_t addr = interpreter.reg[rs1] + offset_signed;
+  interpreter.CheckAccess(addr, 1);
   uint32_t val = interpreter.dat[addr];
   interpreter.reg[rd] = val;
   interpreter.reg[0] = 0;
@@ -618,6 +1566,7 @@ void Execute_lhu(RV32IInterpreter &interpreter, uint32_t instruction) {
   }
   int32_t offset_signed = *reinterpret_cast<int32_t *>(&offset);
   uint32_t addr = interpreter.reg[rs1] + offset_signed;
+  interpreter.CheckAccess(addr, 2);
   uint32_t val = *(reinterpret_cast<uint16_t *>(&interpreter.dat[addr]));
   interpreter.reg[rd] = val;
   interpreter.reg[0] = 0;
@@ -642,7 +1591,9 @@ void Execute_sb(RV32IInterpreter &interpreter, uint32_t instruction) {
   }
   int32_t offset_signed = *reinterpret_cast<int32_t *>(&offset);
   uint32_t addr = interpreter.reg[rs1] + offset_signed;
+  interpreter.CheckAccess(addr, 1);
   interpreter.dat[addr] = interpreter.reg[rs2] & 0xFF;
+  interpreter.InvalidateCode(addr, 1);
   interpreter.PC += 4;
 }
 void Execute_sh(RV32IInterpreter &interpreter, uint32_t instruction) {
@@ -664,7 +1615,9 @@ void Execute_sh(RV32IInterpreter &interpreter, uint32_t instruction) {
   }
   int32_t offset_signed = *reinterpret_cast<int32_t *>(&offset);
   uint32_t addr = interpreter.reg[rs1] + offset_signed;
+  interpreter.CheckAccess(addr, 2);
   *reinterpret_cast<uint16_t *>(&interpreter.dat[addr]) = interpreter.reg[rs2] & 0xFFFF;
+  interpreter.InvalidateCode(addr, 2);
   interpreter.PC += 4;
 }
 void Execute_sw(RV32IInterpreter &interpreter, uint32_t instruction) {
@@ -686,7 +1639,9 @@ void Execute_sw(RV32IInterpreter &interpreter, uint32_t instruction) {
   }
   int32_t offset_signed = *reinterpret_cast<int32_t *>(&offset);
   uint32_t addr = interpreter.reg[rs1] + offset_signed;
+  interpreter.CheckAccess(addr, 4);
   *reinterpret_cast<uint32_t *>(&interpreter.dat[addr]) = interpreter.reg[rs2];
+  interpreter.InvalidateCode(addr, 4);
   interpreter.PC += 4;
 }
 void Execute_addi(RV32IInterpreter &interpreter, uint32_t instruction) {
@@ -0,0 +1,32 @@
+#include <cstdio>
+#include <exception>
+#include <iostream>
+#include "traceevents.h"
+// decode a binary trace written with --trace into one line of text per event
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <trace file>" << std::endl;
+    return 1;
+  }
+  try {
+    dark::trace::Reader reader(argv[1]);
+    dark::trace::Record record;
+    while (reader.next(record)) {
+      const auto *info = ZYM::GetTraceEventInfo(record.event);
+      if (info == nullptr) {
+        std::printf("%10u event_%u %08x %08x %08x\n", record.cycle, record.event, record.args[0], record.args[1],
+                    record.args[2]);
+        continue;
+      }
+      std::printf("%10u %-9s", record.cycle, info->name);
+      for (int i = 0; i < 3; i++) {
+        std::printf(info->hex[i] ? " %s=%08x" : " %s=%u", info->args[i], record.args[i]);
+      }
+      std::printf("\n");
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
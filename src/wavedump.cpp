@@ -0,0 +1,31 @@
+#include <exception>
+#include <iostream>
+#include <utility>
+#include <vector>
+#include "waveform.h"
+// convert a binary waveform written with --wave into VCD
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " <waveform file> <vcd file>" << std::endl;
+    return 1;
+  }
+  try {
+    dark::wave::Reader reader(argv[1]);
+    dark::wave::Writer writer(argv[2], dark::wave::Format::VCD);
+    for (auto &signal : reader.signals()) {
+      writer.declare(signal.scope, signal.name, signal.width);
+    }
+    unsigned long long cycle;
+    std::vector<std::pair<std::size_t, dark::max_size_t>> changes;
+    while (reader.next(cycle, changes)) {
+      writer.time(cycle);
+      for (auto [index, value] : changes) {
+        writer.change(index, value);
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}